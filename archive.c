@@ -0,0 +1,740 @@
+// archive.c
+#define _GNU_SOURCE     // O_DIRECT, fallocate
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "archive.h"
+
+#define ARCH_ALIGN      4096            // O_DIRECT 对齐要求
+#define ARCH_BUF_MIN    (1024 * 1024)   // 批量缓冲区初始大小
+#define ARCH_REC_HDR    16
+
+struct arch_rec_hdr {
+    uint32_t magic;
+    uint32_t len;
+    uint64_t ts_ms;
+};
+
+struct arch_entry {
+    uint64_t ts_ms;
+    uint64_t offset;
+};
+
+struct arch_seg {
+    uint64_t start_ms;
+    uint64_t end_ms;            // 最后一帧的时间戳
+    uint64_t bytes;             // 有效数据长度
+};
+
+struct archive {
+    char dir[256];
+    struct archive_conf conf;
+    pthread_mutex_t lock;       // 保护 segs、ents、nents_durable
+
+    struct arch_seg *segs;      // 按起始时间排序，写入中的段在最后
+    size_t nsegs, segcap;
+
+    // 当前写入段（只由写线程修改 fd/buf）
+    int fd;                     // -1：没有打开的段
+    struct arch_entry *ents;
+    size_t nents, entcap;
+    size_t nents_durable;       // 已落盘、对读游标可见的条目数
+
+    unsigned char *buf;         // ARCH_ALIGN 对齐的批量缓冲区
+    size_t bufcap;
+    size_t used;
+    uint64_t base;              // buf[0] 对应的文件偏移（ARCH_ALIGN 对齐）
+};
+
+struct archive_cursor {
+    struct archive *a;
+    uint64_t seg_start;
+    int fd;
+    int live;                   // 1：当前段仍在写入，索引从 archive 中读取
+    struct arch_entry *ents;    // 已关闭段的索引副本
+    size_t nents;
+    size_t pos;                 // 下一条记录序号
+    unsigned char *buf;
+    size_t bufcap;
+};
+
+uint64_t archive_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static size_t rec_size(size_t len)
+{
+    return (ARCH_REC_HDR + len + 7) & ~(size_t)7;
+}
+
+static void seg_path(const struct archive *a, uint64_t start, const char *ext,
+                     char *out, size_t n)
+{
+    snprintf(out, n, "%s/seg-%013llu.%s", a->dir, (unsigned long long)start, ext);
+}
+
+static int pwrite_all(int fd, const void *buf, size_t len, uint64_t off)
+{
+    size_t done = 0;
+    while (done < len) {
+        ssize_t ret = pwrite(fd, (const char *)buf + done, len - done, (off_t)(off + done));
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        done += ret;
+    }
+    return 0;
+}
+
+static int pread_all(int fd, void *buf, size_t len, uint64_t off)
+{
+    size_t done = 0;
+    while (done < len) {
+        ssize_t ret = pread(fd, (char *)buf + done, len - done, (off_t)(off + done));
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (ret == 0)
+            return -1;
+        done += ret;
+    }
+    return 0;
+}
+
+static int write_index(const struct archive *a, uint64_t start,
+                       const struct arch_entry *ents, size_t n)
+{
+    char path[300], tmp[310];
+    seg_path(a, start, "idx", path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        perror("archive: open index");
+        return -1;
+    }
+    int ret = pwrite_all(fd, ents, n * sizeof(*ents), 0);
+    close(fd);
+    if (ret == -1 || rename(tmp, path) == -1) {
+        perror("archive: write index");
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static int load_index(const struct archive *a, uint64_t start,
+                      struct arch_entry **ents, size_t *n)
+{
+    char path[300];
+    seg_path(a, start, "idx", path, sizeof(path));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    *n = (size_t)st.st_size / sizeof(struct arch_entry);
+    *ents = malloc(*n ? *n * sizeof(struct arch_entry) : 1);
+    if (!*ents || (*n && pread_all(fd, *ents, *n * sizeof(struct arch_entry), 0) == -1)) {
+        free(*ents);
+        *ents = NULL;
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+// 异常退出后没有索引的段：顺序扫描记录重建索引，并截掉预分配的空白
+static int rebuild_index(struct archive *a, uint64_t start)
+{
+    char path[300];
+    seg_path(a, start, "dat", path, sizeof(path));
+
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    struct stat st;
+    fstat(fd, &st);
+
+    struct arch_entry *ents = NULL;
+    size_t n = 0, cap = 0;
+    uint64_t off = 0;
+    struct arch_rec_hdr hdr;
+    while (off + ARCH_REC_HDR <= (uint64_t)st.st_size &&
+           pread_all(fd, &hdr, sizeof(hdr), off) == 0 &&
+           hdr.magic == ARCHIVE_REC_MAGIC &&
+           off + rec_size(hdr.len) <= (uint64_t)st.st_size) {
+        if (n == cap) {
+            cap = cap ? cap * 2 : 256;
+            struct arch_entry *p = realloc(ents, cap * sizeof(*ents));
+            if (!p)
+                break;
+            ents = p;
+        }
+        ents[n].ts_ms = hdr.ts_ms;
+        ents[n].offset = off;
+        n++;
+        off += rec_size(hdr.len);
+    }
+
+    if (ftruncate(fd, (off_t)off) == -1)
+        perror("archive: truncate");
+    close(fd);
+
+    fprintf(stderr, "archive: rebuilt index of %s (%zu frames)\n", path, n);
+    int ret = write_index(a, start, ents, n);
+    free(ents);
+    return ret;
+}
+
+static int cmp_u64(const void *x, const void *y)
+{
+    uint64_t a = *(const uint64_t *)x, b = *(const uint64_t *)y;
+    return a < b ? -1 : a > b;
+}
+
+static int push_seg(struct archive *a, uint64_t start, uint64_t end, uint64_t bytes)
+{
+    if (a->nsegs == a->segcap) {
+        size_t cap = a->segcap ? a->segcap * 2 : 64;
+        struct arch_seg *p = realloc(a->segs, cap * sizeof(*p));
+        if (!p)
+            return -1;
+        a->segs = p;
+        a->segcap = cap;
+    }
+    a->segs[a->nsegs].start_ms = start;
+    a->segs[a->nsegs].end_ms = end;
+    a->segs[a->nsegs].bytes = bytes;
+    a->nsegs++;
+    return 0;
+}
+
+static void remove_seg_files(const struct archive *a, uint64_t start)
+{
+    char path[300];
+    seg_path(a, start, "dat", path, sizeof(path));
+    unlink(path);
+    seg_path(a, start, "idx", path, sizeof(path));
+    unlink(path);
+}
+
+static int scan_dir(struct archive *a)
+{
+    DIR *d = opendir(a->dir);
+    if (!d) {
+        perror("archive: opendir");
+        return -1;
+    }
+
+    uint64_t *starts = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        unsigned long long start;
+        char ext[8];
+        if (sscanf(de->d_name, "seg-%llu.%7s", &start, ext) != 2 || strcmp(ext, "dat") != 0)
+            continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            uint64_t *p = realloc(starts, cap * sizeof(*p));
+            if (!p)
+                break;
+            starts = p;
+        }
+        starts[n++] = start;
+    }
+    closedir(d);
+
+    qsort(starts, n, sizeof(*starts), cmp_u64);
+
+    for (size_t i = 0; i < n; ++i) {
+        struct arch_entry *ents = NULL;
+        size_t nents = 0;
+        if (load_index(a, starts[i], &ents, &nents) == -1) {
+            if (rebuild_index(a, starts[i]) == -1 ||
+                load_index(a, starts[i], &ents, &nents) == -1)
+                continue;
+        }
+        if (nents == 0) {
+            remove_seg_files(a, starts[i]);
+            free(ents);
+            continue;
+        }
+
+        char path[300];
+        struct stat st;
+        seg_path(a, starts[i], "dat", path, sizeof(path));
+        stat(path, &st);
+        push_seg(a, starts[i], ents[nents - 1].ts_ms, (uint64_t)st.st_size);
+        free(ents);
+    }
+
+    free(starts);
+    return 0;
+}
+
+struct archive *archive_open(const char *dir, const struct archive_conf *conf)
+{
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+        perror("archive: mkdir");
+        return NULL;
+    }
+
+    struct archive *a = calloc(1, sizeof(*a));
+    if (!a)
+        return NULL;
+    snprintf(a->dir, sizeof(a->dir), "%s", dir);
+    a->conf = *conf;
+    a->fd = -1;
+    pthread_mutex_init(&a->lock, NULL);
+
+    a->bufcap = ARCH_BUF_MIN;
+    if (posix_memalign((void **)&a->buf, ARCH_ALIGN, a->bufcap) != 0) {
+        free(a);
+        return NULL;
+    }
+
+    if (scan_dir(a) == -1) {
+        archive_close(a);
+        return NULL;
+    }
+    return a;
+}
+
+// 按容量和时长删除最旧的已关闭段（调用者持锁）
+static void enforce_retention(struct archive *a, uint64_t now_ms)
+{
+    size_t keep_from = 0;
+    uint64_t total = 0;
+    for (size_t i = 0; i < a->nsegs; ++i)
+        total += a->segs[i].bytes;
+    // 写入中的段已按整段预分配，按 segment_bytes 计
+    if (a->fd != -1 && a->segs[a->nsegs - 1].bytes < a->conf.segment_bytes)
+        total += a->conf.segment_bytes - a->segs[a->nsegs - 1].bytes;
+
+    // 写入中的段永不删除
+    size_t closed = a->fd != -1 ? a->nsegs - 1 : a->nsegs;
+    while (keep_from < closed) {
+        const struct arch_seg *s = &a->segs[keep_from];
+        int too_big = a->conf.max_bytes && total > a->conf.max_bytes;
+        int too_old = a->conf.max_age_ms && s->end_ms + a->conf.max_age_ms < now_ms;
+        if (!too_big && !too_old)
+            break;
+        remove_seg_files(a, s->start_ms);
+        total -= s->bytes;
+        keep_from++;
+    }
+
+    if (keep_from) {
+        memmove(a->segs, a->segs + keep_from, (a->nsegs - keep_from) * sizeof(*a->segs));
+        a->nsegs -= keep_from;
+    }
+}
+
+static int open_segment(struct archive *a, uint64_t ts_ms)
+{
+    // 起始时间必须递增（时钟回拨时顺延），以保证段文件名唯一且有序
+    pthread_mutex_lock(&a->lock);
+    if (a->nsegs && ts_ms <= a->segs[a->nsegs - 1].end_ms)
+        ts_ms = a->segs[a->nsegs - 1].end_ms + 1;
+    pthread_mutex_unlock(&a->lock);
+
+    char path[300];
+    seg_path(a, ts_ms, "dat", path, sizeof(path));
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    int fd = open(path, flags | (a->conf.direct_io ? O_DIRECT : 0), 0644);
+    if (fd == -1 && a->conf.direct_io && errno == EINVAL) {
+        fprintf(stderr, "archive: O_DIRECT not supported on %s, using buffered writes\n", a->dir);
+        a->conf.direct_io = 0;
+        fd = open(path, flags, 0644);
+    }
+    if (fd == -1) {
+        perror("archive: open segment");
+        return -1;
+    }
+
+    // 预分配整段，避免追加写时反复分配块；文件系统不支持时忽略
+    if (fallocate(fd, 0, 0, (off_t)a->conf.segment_bytes) == -1 && errno != EOPNOTSUPP)
+        perror("archive: fallocate");
+
+    pthread_mutex_lock(&a->lock);
+    if (push_seg(a, ts_ms, ts_ms, 0) == -1) {
+        pthread_mutex_unlock(&a->lock);
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    a->fd = fd;
+    a->nents = 0;
+    a->nents_durable = 0;
+    enforce_retention(a, archive_now_ms());
+    pthread_mutex_unlock(&a->lock);
+
+    a->base = 0;
+    a->used = 0;
+    return 0;
+}
+
+// 写出批量缓冲区。O_DIRECT 时按块写，未满的尾块留在缓冲区，下次连同新数据重写
+static int flush_buffer(struct archive *a)
+{
+    // 上次刷新后没有新帧：O_DIRECT 留下的尾块已经在盘上，不必重写
+    if (a->used == 0 || a->fd == -1 || a->nents == a->nents_durable)
+        return 0;
+
+    size_t wlen = a->used;
+    if (a->conf.direct_io) {
+        wlen = (a->used + ARCH_ALIGN - 1) & ~(size_t)(ARCH_ALIGN - 1);
+        memset(a->buf + a->used, 0, wlen - a->used);
+    }
+    if (pwrite_all(a->fd, a->buf, wlen, a->base) == -1) {
+        perror("archive: write");
+        return -1;
+    }
+
+    uint64_t end = a->base + a->used;
+    if (a->conf.direct_io) {
+        size_t done = a->used & ~(size_t)(ARCH_ALIGN - 1);
+        memmove(a->buf, a->buf + done, a->used - done);
+        a->base += done;
+        a->used -= done;
+    } else {
+        a->base += a->used;
+        a->used = 0;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    a->nents_durable = a->nents;
+    a->segs[a->nsegs - 1].bytes = end;
+    pthread_mutex_unlock(&a->lock);
+    return 0;
+}
+
+static void close_segment(struct archive *a)
+{
+    flush_buffer(a);
+
+    uint64_t end = a->base + a->used;
+    if (ftruncate(a->fd, (off_t)end) == -1)
+        perror("archive: truncate");
+    fdatasync(a->fd);
+
+    // 先写索引再标记为已关闭，读游标看到已关闭时索引一定存在
+    pthread_mutex_lock(&a->lock);
+    uint64_t start = a->segs[a->nsegs - 1].start_ms;
+    pthread_mutex_unlock(&a->lock);
+    write_index(a, start, a->ents, a->nents);
+
+    pthread_mutex_lock(&a->lock);
+    close(a->fd);
+    a->fd = -1;
+    a->nents = 0;
+    a->nents_durable = 0;
+    pthread_mutex_unlock(&a->lock);
+}
+
+int archive_append(struct archive *a, const void *data, size_t len, uint64_t ts_ms)
+{
+    size_t rs = rec_size(len);
+
+    if (a->fd != -1 && a->nents && a->base + a->used + rs > a->conf.segment_bytes)
+        close_segment(a);
+    if (a->fd == -1 && open_segment(a, ts_ms) == -1)
+        return -1;
+
+    if (a->used + rs > a->bufcap) {
+        if (flush_buffer(a) == -1)
+            return -1;
+        if (a->used + rs > a->bufcap) {
+            // 单帧比缓冲区还大：扩容
+            size_t cap = ((a->used + rs + ARCH_ALIGN - 1) & ~(size_t)(ARCH_ALIGN - 1)) * 2;
+            unsigned char *p;
+            if (posix_memalign((void **)&p, ARCH_ALIGN, cap) != 0)
+                return -1;
+            memcpy(p, a->buf, a->used);
+            free(a->buf);
+            a->buf = p;
+            a->bufcap = cap;
+        }
+    }
+
+    // 时钟回拨时沿用上一帧的时间戳，保证索引有序（segs 只由写线程修改，这里读不需加锁）
+    if (ts_ms < a->segs[a->nsegs - 1].end_ms)
+        ts_ms = a->segs[a->nsegs - 1].end_ms;
+
+    struct arch_rec_hdr hdr = { ARCHIVE_REC_MAGIC, (uint32_t)len, ts_ms };
+    unsigned char *dst = a->buf + a->used;
+    memcpy(dst, &hdr, sizeof(hdr));
+    memcpy(dst + ARCH_REC_HDR, data, len);
+    memset(dst + ARCH_REC_HDR + len, 0, rs - ARCH_REC_HDR - len);
+
+    pthread_mutex_lock(&a->lock);
+    if (a->nents == a->entcap) {
+        size_t cap = a->entcap ? a->entcap * 2 : 1024;
+        struct arch_entry *p = realloc(a->ents, cap * sizeof(*p));
+        if (!p) {
+            pthread_mutex_unlock(&a->lock);
+            return -1;
+        }
+        a->ents = p;
+        a->entcap = cap;
+    }
+    a->ents[a->nents].ts_ms = ts_ms;
+    a->ents[a->nents].offset = a->base + a->used;
+    a->nents++;
+    a->segs[a->nsegs - 1].end_ms = ts_ms;
+    pthread_mutex_unlock(&a->lock);
+
+    a->used += rs;
+    return 0;
+}
+
+int archive_flush(struct archive *a)
+{
+    return flush_buffer(a);
+}
+
+void archive_close(struct archive *a)
+{
+    if (!a)
+        return;
+    if (a->fd != -1)
+        close_segment(a);
+    pthread_mutex_destroy(&a->lock);
+    free(a->segs);
+    free(a->ents);
+    free(a->buf);
+    free(a);
+}
+
+int archive_range(struct archive *a, uint64_t *first_ms, uint64_t *last_ms)
+{
+    int ret = -1;
+    pthread_mutex_lock(&a->lock);
+    if (a->nsegs) {
+        *first_ms = a->segs[0].start_ms;
+        *last_ms = a->segs[a->nsegs - 1].end_ms;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&a->lock);
+    return ret;
+}
+
+// 第一条 ts >= ts_ms 的记录序号
+static size_t lower_bound(const struct arch_entry *ents, size_t n, uint64_t ts_ms)
+{
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ents[mid].ts_ms < ts_ms)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// 游标进入起始时间为 start 的段。只做文件 I/O、不持锁，读索引不会卡住写线程；
+// 段可能在此期间被关闭（live 过时）或因保留策略删除（打开失败）
+static int cursor_enter(struct archive_cursor *c, uint64_t start, int live)
+{
+    char path[300];
+
+    if (c->fd != -1)
+        close(c->fd);
+    free(c->ents);
+    c->ents = NULL;
+    c->nents = 0;
+    c->pos = 0;
+
+    c->seg_start = start;
+    c->live = live;
+    seg_path(c->a, start, "dat", path, sizeof(path));
+    c->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (c->fd == -1)
+        return -1;
+
+    if (!live && load_index(c->a, start, &c->ents, &c->nents) == -1)
+        return -1;
+    return 0;
+}
+
+// 游标当前段是否仍是写入中的段（调用者持锁）
+static int cursor_still_live(const struct archive_cursor *c)
+{
+    const struct archive *a = c->a;
+    return a->fd != -1 && a->nsegs && a->segs[a->nsegs - 1].start_ms == c->seg_start;
+}
+
+// 起始时间晚于 start 的第一段的序号，没有时为 nsegs（调用者持锁）
+static size_t next_seg(const struct archive *a, uint64_t start)
+{
+    size_t i = 0;
+    while (i < a->nsegs && a->segs[i].start_ms <= start)
+        i++;
+    return i;
+}
+
+struct archive_cursor *archive_seek(struct archive *a, uint64_t ts_ms)
+{
+    struct archive_cursor *c = calloc(1, sizeof(*c));
+    if (!c)
+        return NULL;
+    c->a = a;
+    c->fd = -1;
+
+    pthread_mutex_lock(&a->lock);
+    if (a->nsegs == 0) {
+        pthread_mutex_unlock(&a->lock);
+        free(c);
+        return NULL;
+    }
+
+    // 段二分：最后一个 start <= ts 的段；若其已全部早于 ts，则取下一段
+    size_t lo = 0, hi = a->nsegs;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a->segs[mid].start_ms <= ts_ms)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    size_t i = lo ? lo - 1 : 0;
+    if (a->segs[i].end_ms < ts_ms && i + 1 < a->nsegs)
+        i++;
+    uint64_t start = a->segs[i].start_ms;
+    int live = i == a->nsegs - 1 && a->fd != -1;
+    pthread_mutex_unlock(&a->lock);
+
+    if (cursor_enter(c, start, live) == -1) {
+        archive_cursor_close(c);
+        return NULL;
+    }
+
+    // 段内二分；落在最后一段末尾说明 ts 之后还没有录像
+    int at_end;
+    pthread_mutex_lock(&a->lock);
+    if (c->live && cursor_still_live(c)) {
+        c->pos = lower_bound(a->ents, a->nents_durable, ts_ms);
+        at_end = c->pos >= a->nents_durable;
+        pthread_mutex_unlock(&a->lock);
+    } else {
+        pthread_mutex_unlock(&a->lock);
+        // 打开后段已关闭：此时索引一定已写出
+        if (c->live) {
+            c->live = 0;
+            if (load_index(a, c->seg_start, &c->ents, &c->nents) == -1) {
+                archive_cursor_close(c);
+                return NULL;
+            }
+        }
+        c->pos = lower_bound(c->ents, c->nents, ts_ms);
+        pthread_mutex_lock(&a->lock);
+        at_end = c->pos >= c->nents && next_seg(a, c->seg_start) == a->nsegs;
+        pthread_mutex_unlock(&a->lock);
+    }
+
+    if (at_end) {
+        archive_cursor_close(c);
+        return NULL;
+    }
+    return c;
+}
+
+ssize_t archive_next(struct archive_cursor *c, const void **data, uint64_t *ts_ms)
+{
+    struct archive *a = c->a;
+    struct arch_entry ent;
+
+    for (;;) {
+        pthread_mutex_lock(&a->lock);
+        if (c->live && !cursor_still_live(c)) {
+            // 段已关闭，改用磁盘上的索引继续（不持锁读）
+            pthread_mutex_unlock(&a->lock);
+            c->live = 0;
+            if (load_index(a, c->seg_start, &c->ents, &c->nents) == -1)
+                return -1;
+            continue;
+        }
+
+        if (c->live) {
+            if (c->pos >= a->nents_durable) {
+                pthread_mutex_unlock(&a->lock);
+                return 0;   // 追上了写入进度
+            }
+            ent = a->ents[c->pos];
+        } else if (c->pos < c->nents) {
+            ent = c->ents[c->pos];
+        } else {
+            // 本段读完，进入下一段
+            size_t i = next_seg(a, c->seg_start);
+            if (i == a->nsegs) {
+                pthread_mutex_unlock(&a->lock);
+                return 0;
+            }
+            uint64_t start = a->segs[i].start_ms;
+            int live = i == a->nsegs - 1 && a->fd != -1;
+            pthread_mutex_unlock(&a->lock);
+            if (cursor_enter(c, start, live) == -1)
+                return -1;
+            continue;
+        }
+        pthread_mutex_unlock(&a->lock);
+        break;
+    }
+
+    struct arch_rec_hdr hdr;
+    if (pread_all(c->fd, &hdr, sizeof(hdr), ent.offset) == -1 || hdr.magic != ARCHIVE_REC_MAGIC)
+        return -1;
+
+    if (hdr.len > c->bufcap) {
+        unsigned char *p = realloc(c->buf, hdr.len);
+        if (!p)
+            return -1;
+        c->buf = p;
+        c->bufcap = hdr.len;
+    }
+    if (pread_all(c->fd, c->buf, hdr.len, ent.offset + ARCH_REC_HDR) == -1)
+        return -1;
+
+    c->pos++;
+    *data = c->buf;
+    *ts_ms = hdr.ts_ms;
+    return (ssize_t)hdr.len;
+}
+
+void archive_cursor_close(struct archive_cursor *c)
+{
+    if (!c)
+        return;
+    if (c->fd != -1)
+        close(c->fd);
+    free(c->ents);
+    free(c->buf);
+    free(c);
+}
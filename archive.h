@@ -0,0 +1,89 @@
+// archive.h
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * 分段录像归档
+ *
+ * 帧按到达顺序追加到预分配的定长段文件 <dir>/seg-<起始毫秒>.dat，
+ * 每条记录为 16 字节记录头 + 数据（8 字节对齐）。写入先进入对齐的批量缓冲区，
+ * 满或定时刷新时一次 pwrite，可选 O_DIRECT。每段有一个紧凑的时间索引
+ * <dir>/seg-<起始毫秒>.idx（{ts_ms, offset} 数组），段关闭时写出；
+ * 当前段的索引在内存中。按时间查找为两次二分：先找段，再找段内记录。
+ * 启动时会为缺少索引的段（异常退出）扫描重建索引。
+ *
+ * 时间戳为 CLOCK_REALTIME 毫秒（Unix 时间）。
+ * 写入只由一个线程进行；读游标可在其他线程并发使用。
+ */
+
+#define ARCHIVE_REC_MAGIC 0x46525350u   /* "PSRF" */
+
+struct archive_conf {
+    uint64_t segment_bytes;     // 段文件预分配大小
+    uint64_t max_bytes;         // 总容量上限，0 不限
+    uint64_t max_age_ms;        // 最长保留时间，0 不限
+    int direct_io;              // 1：O_DIRECT 写入
+};
+
+struct archive;
+struct archive_cursor;
+
+/**
+ * @brief 打开（必要时创建）归档目录，扫描已有段
+ */
+struct archive *archive_open(const char *dir, const struct archive_conf *conf);
+
+/**
+ * @brief 追加一帧（只拷贝进批量缓冲区，缓冲区满时写盘）
+ * ts_ms 早于上一帧时（时钟回拨）按上一帧的时间戳记录
+ * @return 0 成功，-1 失败
+ */
+int archive_append(struct archive *a, const void *data, size_t len, uint64_t ts_ms);
+
+/**
+ * @brief 把批量缓冲区写盘，使已追加的帧对读游标可见
+ */
+int archive_flush(struct archive *a);
+
+/**
+ * @brief 刷新、写出当前段索引并关闭
+ */
+void archive_close(struct archive *a);
+
+/**
+ * @brief 归档覆盖的时间范围
+ * @return 0 成功，-1 归档为空
+ */
+int archive_range(struct archive *a, uint64_t *first_ms, uint64_t *last_ms);
+
+/**
+ * @brief 定位到时间戳 >= ts_ms 的第一帧
+ * @return 游标；ts_ms 之后没有录像或失败返回 NULL
+ */
+struct archive_cursor *archive_seek(struct archive *a, uint64_t ts_ms);
+
+/**
+ * @brief 读取下一帧
+ * @param data 输出：指向游标内部缓冲区，下次调用前有效
+ * @param ts_ms 输出：帧时间戳
+ * @return 帧长度；0 已到归档末尾（之后还可能有新帧）；-1 出错
+ */
+ssize_t archive_next(struct archive_cursor *c, const void **data, uint64_t *ts_ms);
+
+void archive_cursor_close(struct archive_cursor *c);
+
+uint64_t archive_now_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARCHIVE_H
@@ -0,0 +1,533 @@
+// bench.cpp
+/*
+ * 热路径微基准：串口帧解析/重同步、命令分发、消息头编解码、
+ * 帧复制与扇出、合成采集后端的出队/入队循环。
+ * 被测的都是服务端实际使用的代码（poller、dispatch、client 等），不是副本。
+ *
+ * 每项基准先校准迭代次数，再与其他项交错重复多轮取最快一轮，结果以 JSON 输出；
+ * 给出基线文件时逐项比较，超出该项容差的再跑一遍确认，仍变慢即以非零状态退出。
+ * 基线与机器相关，换机器后用 -o 重新生成（最好取几次运行的中位数）。
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+extern "C" {
+#include "cam.h"
+#include "poller.h"
+#include "proto.h"
+#include "command.h"
+#include "trace.h"
+}
+#include "frame.h"
+#include "client.h"
+#include "dispatch.h"
+
+#define BENCH_ROUNDS        15              // 各项交错执行的轮数，取最快一轮
+#define BENCH_ROUND_MS      100
+#define BENCH_CALIBRATE_NS  10000000ULL     // 校准到单次运行至少 10ms
+#define SERIAL_CHUNK        32              // 模拟串口每次 read 的字节数
+#define FANOUT_FRAME_SIZE   (32 * 1024)
+
+struct bench_result {
+    std::string name;
+    const char *unit;           // 一次操作的含义
+    uint64_t ops;
+    double ns_per_op;
+    double mb_per_s;            // 不适用时为 0
+};
+
+// 执行约 iters 次操作，返回实际完成的操作数，bytes 累加处理的字节数
+typedef uint64_t (*bench_fn)(uint64_t iters, uint64_t *bytes);
+
+static volatile uint64_t g_sink;    // 防止编译器消除被测代码
+
+/* ---------- 串口帧解析 ---------- */
+
+static std::vector<unsigned char> g_serial_stream;
+static uint64_t g_serial_frames;
+
+static void on_frame(void *, unsigned short addr, const unsigned char *, size_t len, int)
+{
+    g_sink += addr + len;
+}
+
+static size_t build_frame(unsigned char *f, unsigned char type, unsigned char id,
+                          const unsigned char *data, size_t n)
+{
+    size_t len = 10 + n;    // 9 字节帧头 + 数据 + CRC
+    f[0] = POLL_SOF;
+    f[1] = 0x01;
+    f[2] = (unsigned char)(len - 2);
+    f[3] = 0x01; f[4] = 0x57; f[5] = 0x40;
+    f[6] = type;
+    f[7] = id;
+    f[8] = 0x00;
+    memcpy(f + 9, data, n);
+    f[len - 1] = poller_crc8(f, len - 1);
+    return len;
+}
+
+// 生成一段带噪声的字节流：温湿度/光照帧交替，夹杂伪帧头、截断帧和 CRC 错误帧
+static void build_serial_stream(size_t nframes)
+{
+    unsigned int rng = 12345;
+    unsigned char f[POLL_FRAME_MAX];
+    for (size_t i = 0; i < nframes; ++i) {
+        rng = rng * 1103515245 + 12345;
+        unsigned char data[4] = { (unsigned char)(rng >> 8), (unsigned char)(rng >> 16),
+                                  (unsigned char)(rng >> 24), 0x3c };
+        size_t len = (i & 1) ? build_frame(f, 0x2a, (unsigned char)(i % 8), data, 2)
+                             : build_frame(f, 0x2b, (unsigned char)(i % 8), data, 4);
+
+        if (i % 16 == 5) {
+            // 截断帧：只有前半截，后面紧跟下一帧
+            g_serial_stream.insert(g_serial_stream.end(), f, f + len / 2);
+        } else if (i % 16 == 9) {
+            f[9] ^= 0xff;   // CRC 错误
+            g_serial_stream.insert(g_serial_stream.end(), f, f + len);
+        } else {
+            g_serial_stream.insert(g_serial_stream.end(), f, f + len);
+            g_serial_frames++;
+        }
+        if (i % 16 == 12) {
+            static const unsigned char noise[] = { 0x00, POLL_SOF, 0xff, POLL_SOF, 0x01, 0x7f };
+            g_serial_stream.insert(g_serial_stream.end(), noise, noise + sizeof(noise));
+        }
+    }
+}
+
+static int load_serial_stream(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    unsigned char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        g_serial_stream.insert(g_serial_stream.end(), buf, buf + n);
+    fclose(fp);
+
+    // 用一次完整解析统计有效帧数，作为每次操作的计数单位
+    struct poller *p = poller_create(-1, 1, 1000);
+    for (size_t off = 0; off < g_serial_stream.size(); off += SERIAL_CHUNK) {
+        size_t n = std::min((size_t)SERIAL_CHUNK, g_serial_stream.size() - off);
+        g_serial_frames += poller_feed(p, g_serial_stream.data() + off, n, 0);
+    }
+    poller_destroy(p);
+    if (g_serial_frames == 0) {
+        fprintf(stderr, "%s: no valid frames\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t bench_serial_parse(uint64_t iters, uint64_t *bytes)
+{
+    struct poller *p = poller_create(-1, 1, 1000);
+    poller_set_callback(p, on_frame, nullptr);
+
+    uint64_t frames = 0;
+    uint64_t passes = (iters + g_serial_frames - 1) / g_serial_frames;
+    for (uint64_t i = 0; i < passes; ++i) {
+        const unsigned char *s = g_serial_stream.data();
+        size_t total = g_serial_stream.size();
+        for (size_t off = 0; off < total; off += SERIAL_CHUNK) {
+            size_t n = std::min((size_t)SERIAL_CHUNK, total - off);
+            frames += poller_feed(p, s + off, n, 0);
+        }
+        *bytes += total;
+    }
+    poller_destroy(p);
+    return frames;
+}
+
+/* ---------- 命令分发 ---------- */
+
+// 本地模式的串口命令：只查命令表，不发串口
+static void bench_local_command(const char *cmd)
+{
+    const struct command *c = command_find(cmd);
+    g_sink += c ? c->frame_len : 1;
+}
+
+// 与网络线程相同：client_recv 从非阻塞套接字读出并分行，逐条交给 client_command
+static uint64_t bench_command_dispatch(uint64_t iters, uint64_t *bytes)
+{
+    // 包含 \r\n 结尾、未知命令和网络层命令
+    static const char lines[] =
+        "wind_on\nwind_off\r\nlock_on\nlock_off\nget_temp_val\nsites\nsubscribe_sensors\nbogus\n";
+    const uint64_t per_pass = 8;
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) == -1) {
+        perror("socketpair");
+        exit(-1);
+    }
+    Client c;
+    c.fd = sv[1];
+    // 单个本地视频源、无归档；回复排进 c.ctrl（有上限），不发送
+    FramePool pool;
+    std::vector<std::unique_ptr<Upstream> > upstreams;
+    NetState st;
+    st.latest.resize(1);
+    st.sensors.resize(1);
+    const DispatchEnv env = { 1, &upstreams, nullptr, &pool, bench_local_command };
+    auto on_line = [&](const char *line) { client_command(c, st, env, line); };
+
+    uint64_t ops = 0;
+    while (ops < iters) {
+        if (send(sv[0], lines, sizeof(lines) - 1, MSG_NOSIGNAL) != (ssize_t)sizeof(lines) - 1 ||
+            client_recv(c, on_line) == -1) {
+            perror("command_dispatch");
+            exit(-1);
+        }
+        ops += per_pass;
+        *bytes += sizeof(lines) - 1;
+    }
+
+    close(sv[0]);
+    close(sv[1]);
+    return ops;
+}
+
+/* ---------- 消息头编解码 ---------- */
+
+static uint64_t bench_proto_header(uint64_t iters, uint64_t *bytes)
+{
+    static const int types[] = { PROTO_IMAGE, PROTO_SENSOR, PROTO_IMAGE, PROTO_TEXT };
+    char hdr[PROTO_HDR_LEN];
+    for (uint64_t i = 0; i < iters; ++i) {
+        int type;
+        uint32_t len;
+        proto_encode_header(hdr, types[i & 3], (uint32_t)(i * 2654435761u) % PROTO_MAX_LEN);
+        if (proto_decode_header(hdr, &type, &len) == 0)
+            g_sink += len + type;
+    }
+    *bytes += iters * PROTO_HDR_LEN;
+    return iters;
+}
+
+/* ---------- 帧复制与扇出 ---------- */
+
+static int g_fanout = 4;
+
+static uint64_t bench_fanout(uint64_t iters, uint64_t *bytes)
+{
+    // 客户端一侧阻塞读，服务端一侧与网络线程相同：非阻塞套接字 + client_flush
+    std::vector<Client> clients(g_fanout);
+    std::vector<int> rx(g_fanout);
+    for (int i = 0; i < g_fanout; ++i) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1 ||
+            fcntl(sv[0], F_SETFL, O_NONBLOCK) == -1) {
+            perror("socketpair");
+            exit(-1);
+        }
+        clients[i].fd = sv[0];
+        rx[i] = sv[1];
+    }
+
+    FramePool pool;
+    std::vector<unsigned char> src(FANOUT_FRAME_SIZE, 0x5a);
+    std::vector<unsigned char> sink(FANOUT_FRAME_SIZE + PROTO_HDR_LEN);
+
+    for (uint64_t n = 0; n < iters; ++n) {
+        // 采集线程：复制一次；网络线程：投递给每个客户端并发送
+        FramePtr frame = pool.make(src.data(), src.size(), 0, n);
+        size_t want = PROTO_HDR_LEN + frame->data.size();
+
+        for (int i = 0; i < g_fanout; ++i) {
+            Client &c = clients[i];
+            client_post_frame(c, frame);
+            // 套接字缓冲区放不下整帧时，读走一部分再继续发
+            for (size_t got = 0; got < want;) {
+                if (client_flush(c) == -1) {
+                    perror("client_flush");
+                    exit(-1);
+                }
+                ssize_t ret = recv(rx[i], sink.data(), sink.size(), 0);
+                if (ret <= 0) {
+                    perror("recv");
+                    exit(-1);
+                }
+                got += ret;
+            }
+            *bytes += want;
+        }
+    }
+
+    for (int i = 0; i < g_fanout; ++i) {
+        close(clients[i].fd);
+        close(rx[i]);
+    }
+    return iters;
+}
+
+/* ---------- 采集出队/入队 ---------- */
+
+static uint64_t bench_camera_cycle(uint64_t iters, uint64_t *bytes)
+{
+    char dev[] = "synthetic:0";
+    unsigned int width = 640, height = 480, size = 0, ismjpeg = 0;
+    int fd = camera_init(dev, &width, &height, &size, &ismjpeg);
+    if (fd == -1 || camera_start(fd) == -1) {
+        fprintf(stderr, "synthetic camera init failed\n");
+        exit(-1);
+    }
+
+    void *ptr;
+    unsigned int index;
+    for (uint64_t i = 0; i < iters; ++i) {
+        if (camera_dqbuf(fd, &ptr, &size, &index) == -1 || camera_eqbuf(fd, index) == -1) {
+            fprintf(stderr, "synthetic camera dqbuf/eqbuf failed\n");
+            exit(-1);
+        }
+        *bytes += size;
+    }
+
+    camera_stop(fd);
+    camera_exit(fd);
+    return iters;
+}
+
+/* ---------- 运行与比较 ---------- */
+
+struct bench_case {
+    const char *name;
+    const char *unit;
+    bench_fn fn;
+    bool throughput;            // 是否报告 MB/s
+    double tolerance;           // 允许的变慢百分比，按各项在同一台机器上的波动设定
+};
+
+static const bench_case cases[] = {
+    // 容差约为同一台机器上连续 10 次运行中最慢一次相对中位数的 1.5 倍
+    { "serial_parse",     "frame",   bench_serial_parse,     true,  15 },
+    { "command_dispatch", "command", bench_command_dispatch, false, 30 },
+    { "proto_header",     "header",  bench_proto_header,     false, 35 },
+    { "frame_fanout",     "frame",   bench_fanout,           true,  20 },
+    { "camera_cycle",     "frame",   bench_camera_cycle,     false, 25 },
+};
+
+// 校准：迭代次数翻倍直到一次运行足够长，再按目标时长换算
+static uint64_t calibrate(const bench_case &bc, uint64_t round_ns)
+{
+    uint64_t bytes = 0;
+    uint64_t iters = 1;
+    for (;;) {
+        uint64_t t0 = trace_now_ns();
+        bc.fn(iters, &bytes);
+        uint64_t dt = trace_now_ns() - t0;
+        if (dt >= BENCH_CALIBRATE_NS)
+            return std::max<uint64_t>(1, (uint64_t)((double)iters * round_ns / dt));
+        iters *= 2;
+    }
+}
+
+// 运行一轮，结果并入 res：取各轮中最快的一次（噪声只会让测量变慢）
+static void run_round(const bench_case &bc, uint64_t iters, bench_result &res)
+{
+    uint64_t bytes = 0;
+    uint64_t t0 = trace_now_ns();
+    uint64_t ops = bc.fn(iters, &bytes);
+    uint64_t dt = trace_now_ns() - t0;
+
+    double ns = (double)dt / (ops ? ops : 1);
+    res.ops += ops;
+    if (res.ns_per_op == 0 || ns < res.ns_per_op)
+        res.ns_per_op = ns;
+    if (bc.throughput)
+        res.mb_per_s = std::max(res.mb_per_s, bytes * 1000.0 / dt);
+}
+
+static void write_json(FILE *fp, const std::vector<bench_result> &results)
+{
+    fprintf(fp, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const bench_result &r = results[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"unit\": \"%s\", \"ops\": %llu, "
+                    "\"ns_per_op\": %.2f, \"mb_per_s\": %.1f}%s\n",
+                r.name.c_str(), r.unit, (unsigned long long)r.ops,
+                r.ns_per_op, r.mb_per_s, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+// 从基线 JSON 中取出某项的 ns_per_op（只认本程序输出的格式），没有返回 -1
+static double baseline_lookup(const std::string &json, const std::string &name)
+{
+    std::string key = "\"name\": \"" + name + "\"";
+    size_t pos = json.find(key);
+    if (pos == std::string::npos)
+        return -1;
+    size_t end = json.find('}', pos);
+    size_t v = json.find("\"ns_per_op\":", pos);
+    if (v == std::string::npos || v > end)
+        return -1;
+    return strtod(json.c_str() + v + strlen("\"ns_per_op\":"), nullptr);
+}
+
+static int read_file(const char *path, std::string &out)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        out.append(buf, n);
+    fclose(fp);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -o <file>   write JSON results to file (default stdout)\n"
+        "  -b <file>   compare against a baseline JSON written by -o\n"
+        "  -t <pct>    regression threshold in percent for every benchmark\n"
+        "              (default: each benchmark's own tolerance, 15..35)\n"
+        "  -T <ms>     target time per round (default 100)\n"
+        "  -r <n>      rounds per benchmark, the fastest one is reported (default 15)\n"
+        "  -f <name>   run only benchmarks whose name contains this string\n"
+        "  -s <file>   raw serial capture to parse instead of the generated stream\n"
+        "  -n <n>      number of clients for frame_fanout (default 4)\n"
+        "Exits with 1 when any benchmark is slower than baseline by more than its tolerance.\n",
+        prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = nullptr;
+    const char *baseline_path = nullptr;
+    const char *filter = nullptr;
+    const char *serial_path = nullptr;
+    double threshold = 0;       // 0：使用各项自己的容差
+    int rounds = BENCH_ROUNDS;
+    uint64_t round_ms = BENCH_ROUND_MS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:b:t:T:r:f:s:n:")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 'b': baseline_path = optarg; break;
+        case 't': threshold = strtod(optarg, nullptr); break;
+        case 'T': round_ms = strtoull(optarg, nullptr, 10); break;
+        case 'r': rounds = atoi(optarg); break;
+        case 'f': filter = optarg; break;
+        case 's': serial_path = optarg; break;
+        case 'n': g_fanout = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (g_fanout < 1 || round_ms == 0 || rounds < 1) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    // 基准自身的计时不需要时间线
+    setenv("PSERVER_TRACE", "0", 1);
+
+    if (serial_path) {
+        if (load_serial_stream(serial_path) == -1)
+            return -1;
+    } else {
+        build_serial_stream(4096);
+    }
+
+    std::string baseline;
+    if (baseline_path && read_file(baseline_path, baseline) == -1)
+        return -1;
+
+    // 先逐项校准，再把各轮交错执行：机器状态的慢变化（降频、邻居负载）
+    // 分摊到每一项的不同轮次上，取最快一轮时就不会整项被拖慢
+    std::vector<const bench_case *> run;
+    std::vector<uint64_t> iters;
+    std::vector<bench_result> results;
+    for (const bench_case &bc : cases) {
+        if (filter && !strstr(bc.name, filter))
+            continue;
+        bench_result r;
+        r.name = bc.name;
+        if (bc.fn == bench_fanout)
+            r.name += "_x" + std::to_string(g_fanout);   // 不同客户端数各自对比基线
+        r.unit = bc.unit;
+        r.ops = 0;
+        r.ns_per_op = 0;
+        r.mb_per_s = 0;
+        run.push_back(&bc);
+        iters.push_back(calibrate(bc, round_ms * 1000000ULL));
+        results.push_back(r);
+    }
+    for (int round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < run.size(); ++i)
+            run_round(*run[i], iters[i], results[i]);
+    }
+
+    // 超出容差的项再跑同样多轮确认：短暂的干扰不会持续，真正的退化会
+    std::vector<double> base(results.size(), -1);
+    std::vector<bool> slow(results.size(), false);
+    if (baseline_path) {
+        for (size_t i = 0; i < results.size(); ++i) {
+            double tolerance = threshold > 0 ? threshold : run[i]->tolerance;
+            base[i] = baseline_lookup(baseline, results[i].name);
+            slow[i] = base[i] > 0 && results[i].ns_per_op > base[i] * (1 + tolerance / 100);
+        }
+        for (int round = 0; round < rounds; ++round) {
+            for (size_t i = 0; i < run.size(); ++i) {
+                if (slow[i])
+                    run_round(*run[i], iters[i], results[i]);
+            }
+        }
+    }
+
+    int regressions = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const bench_result &r = results[i];
+        double tolerance = threshold > 0 ? threshold : run[i]->tolerance;
+
+        fprintf(stderr, "%-18s %12.1f ns/%-8s", r.name.c_str(), r.ns_per_op, r.unit);
+        if (r.mb_per_s > 0)
+            fprintf(stderr, " %10.1f MB/s", r.mb_per_s);
+        if (base[i] > 0) {
+            double delta = (r.ns_per_op / base[i] - 1) * 100;
+            bool regressed = delta > tolerance;
+            fprintf(stderr, "  baseline %.1f (%+.1f%%, max %+.0f%%)%s%s", base[i], delta, tolerance,
+                    slow[i] ? " rechecked" : "", regressed ? "  REGRESSION" : "");
+            regressions += regressed;
+        } else if (baseline_path) {
+            fprintf(stderr, "  (no baseline)");
+        }
+        fprintf(stderr, "\n");
+    }
+
+    FILE *fp = out_path ? fopen(out_path, "w") : stdout;
+    if (!fp) {
+        perror(out_path);
+        return -1;
+    }
+    write_json(fp, results);
+    if (fp != stdout)
+        fclose(fp);
+
+    if (regressions) {
+        fprintf(stderr, "%d benchmark(s) regressed beyond tolerance\n", regressions);
+        return 1;
+    }
+    return 0;
+}
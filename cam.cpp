@@ -3,10 +3,12 @@
 #include <cstdlib>
 #include <cstring>
 #include <cerrno>
+#include <cstdint>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <sys/timerfd.h>
 #include <linux/videodev2.h>
 
 #include "cam.h"
@@ -22,15 +24,86 @@ struct cam_buf {
 // 静态全局变量：仅本文件可见
 static struct cam_buf bufs[REQBUFS_COUNT];
 static struct v4l2_requestbuffers reqbufs;
+static int dqbuf_timeout_ms = 2000;
+
+/*
+ * 合成采集后端：设备路径为 "synthetic[:fps]" 时使用。
+ * 用 timerfd 按帧率产生可读事件，复用 camera_dqbuf 中的 select 逻辑，
+ * 缓冲区内容是带帧号的伪 MJPEG 数据。用于无摄像头时的联调和基准测试。
+ * fps 为 0（"synthetic:0"）时不限速，用于测量出队/入队本身的开销。
+ * "synthetic:<fps>:<path>" 模拟热插拔：path 不存在时打开失败、出队返回 ENODEV。
+ */
+#define SYNTH_PREFIX      "synthetic"
+#define SYNTH_FRAME_SIZE  (32 * 1024)
+#define SYNTH_FREE_RUN_NS 1000          // 不限速时的定时器周期
+
+static int synth_fd = -1;
+static unsigned int synth_fps = 30;
+static unsigned int synth_next = 0;             // 下一个出队的缓冲区
+static int synth_queued[REQBUFS_COUNT];
+static unsigned int synth_seq = 0;
+static char synth_node[256];                    // 模拟的设备节点，空表示常在
+
+static int synth_init(const char *devpath, unsigned int *width, unsigned int *height,
+                      unsigned int *size, unsigned int *ismjpeg)
+{
+    const char *colon = strchr(devpath, ':');
+    synth_fps = colon ? (unsigned int)atoi(colon + 1) : 30;
+    if (synth_fps > 1000)
+        synth_fps = 30;
+
+    const char *node = colon ? strchr(colon + 1, ':') : nullptr;
+    snprintf(synth_node, sizeof(synth_node), "%s", node ? node + 1 : "");
+    if (synth_node[0] && access(synth_node, F_OK) == -1) {
+        errno = ENOENT;
+        return -1;
+    }
 
-int camera_init(char *devpath, unsigned int *width, unsigned int *height,
-                unsigned int *size, unsigned int *ismjpeg)
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    reqbufs.count = REQBUFS_COUNT;
+    for (unsigned int i = 0; i < REQBUFS_COUNT; ++i) {
+        bufs[i].length = SYNTH_FRAME_SIZE;
+        bufs[i].start = malloc(SYNTH_FRAME_SIZE);
+        if (!bufs[i].start) {
+            for (unsigned int j = 0; j < i; ++j)
+                free(bufs[j].start);
+            close(fd);
+            return -1;
+        }
+        // SOI ... EOI，中间填充固定图案
+        unsigned char *p = (unsigned char *)bufs[i].start;
+        memset(p, 0x5a, SYNTH_FRAME_SIZE);
+        p[0] = 0xff; p[1] = 0xd8;
+        p[SYNTH_FRAME_SIZE - 2] = 0xff; p[SYNTH_FRAME_SIZE - 1] = 0xd9;
+        synth_queued[i] = 1;
+    }
+
+    synth_fd = fd;
+    synth_next = 0;
+    *ismjpeg = 1;
+    *size = SYNTH_FRAME_SIZE;
+    (void)width;
+    (void)height;
+    return fd;
+}
+
+// prefer：1 先试 MJPEG，0 先试 YUYV；失败时再试另一种
+static int camera_open(char *devpath, unsigned int *width, unsigned int *height,
+                       unsigned int *size, unsigned int *ismjpeg, int prefer)
 {
     if (!devpath || !width || !height || !size || !ismjpeg) {
         errno = EINVAL;
         return -1;
     }
 
+    if (strncmp(devpath, SYNTH_PREFIX, strlen(SYNTH_PREFIX)) == 0)
+        return synth_init(devpath, width, height, size, ismjpeg);
+
     int fd = open(devpath, O_RDWR | O_NONBLOCK);
     if (fd == -1) {
         perror("open camera device");
@@ -61,18 +134,13 @@ int camera_init(char *devpath, unsigned int *width, unsigned int *height,
     fmt.fmt.pix.height = *height;
     fmt.fmt.pix.field = V4L2_FIELD_ANY;
 
-    // 尝试 MJPEG
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_MJPEG;
-    if (ioctl(fd, VIDIOC_S_FMT, &fmt) == 0) {
-        *ismjpeg = 1;  // ✅ MJPEG 成功
-        goto get_fmt;
-    }
-
-    // 尝试 YUYV
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    if (ioctl(fd, VIDIOC_S_FMT, &fmt) == 0) {
-        *ismjpeg = 0;  // ✅ YUYV 成功
-        goto get_fmt;
+    for (int k = 0; k < 2; ++k) {
+        int mjpeg = (k == 0) == (prefer != 0);
+        fmt.fmt.pix.pixelformat = mjpeg ? V4L2_PIX_FMT_MJPEG : V4L2_PIX_FMT_YUYV;
+        if (ioctl(fd, VIDIOC_S_FMT, &fmt) == 0) {
+            *ismjpeg = mjpeg;  // ✅ 格式设置成功
+            goto get_fmt;
+        }
     }
 
     fprintf(stderr, "Failed to set format (MJPEG or YUYV)\n");
@@ -152,8 +220,45 @@ get_fmt:
     return fd;
 }
 
+int camera_init(char *devpath, unsigned int *width, unsigned int *height,
+                unsigned int *size, unsigned int *ismjpeg)
+{
+    return camera_open(devpath, width, height, size, ismjpeg, 1);
+}
+
+int camera_reopen(char *devpath, unsigned int *width, unsigned int *height,
+                  unsigned int *size, unsigned int *ismjpeg)
+{
+    if (!ismjpeg)
+        return -1;
+    return camera_open(devpath, width, height, size, ismjpeg, *ismjpeg);
+}
+
+const char *camera_node_path(const char *devpath)
+{
+    if (strncmp(devpath, SYNTH_PREFIX, strlen(SYNTH_PREFIX)) != 0)
+        return devpath;
+    const char *colon = strchr(devpath, ':');
+    const char *node = colon ? strchr(colon + 1, ':') : nullptr;
+    return node ? node + 1 : nullptr;
+}
+
+void camera_set_timeout(int timeout_ms)
+{
+    dqbuf_timeout_ms = timeout_ms > 0 ? timeout_ms : 2000;
+}
+
 int camera_start(int fd)
 {
+    if (fd == synth_fd) {
+        struct itimerspec its = {};
+        long period_ns = synth_fps ? 1000000000L / synth_fps : SYNTH_FREE_RUN_NS;
+        its.it_interval.tv_sec = period_ns / 1000000000L;
+        its.it_interval.tv_nsec = period_ns % 1000000000L;
+        its.it_value = its.it_interval;
+        return timerfd_settime(fd, 0, &its, nullptr);
+    }
+
     enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     if (ioctl(fd, VIDIOC_STREAMON, &type) == -1) {
         perror("VIDIOC_STREAMON");
@@ -176,8 +281,8 @@ int camera_dqbuf(int fd, void **buf, unsigned int *size, unsigned int *index)
     while (1) {
         FD_ZERO(&fds);
         FD_SET(fd, &fds);
-        timeout.tv_sec = 2;
-        timeout.tv_usec = 0;
+        timeout.tv_sec = dqbuf_timeout_ms / 1000;
+        timeout.tv_usec = (dqbuf_timeout_ms % 1000) * 1000;
 
         int ret = select(fd + 1, &fds, nullptr, nullptr, &timeout);
         if (ret == -1) {
@@ -186,9 +291,34 @@ int camera_dqbuf(int fd, void **buf, unsigned int *size, unsigned int *index)
             return -1;
         } else if (ret == 0) {
             fprintf(stderr, "dqbuf: timeout\n");
+            errno = ETIMEDOUT;
             return -1;
         }
 
+        if (fd == synth_fd) {
+            if (synth_node[0] && access(synth_node, F_OK) == -1) {
+                errno = ENODEV;     // 模拟的设备已拔出
+                return -1;
+            }
+            uint64_t expirations;
+            if (read(fd, &expirations, sizeof(expirations)) == -1)
+                continue;   // 被其他读者抢先，重新等待
+            if (!synth_queued[synth_next]) {
+                // 所有缓冲区都在用户手里，与真实驱动一样丢弃这一帧
+                continue;
+            }
+            unsigned int i = synth_next;
+            synth_next = (synth_next + 1) % REQBUFS_COUNT;
+            synth_queued[i] = 0;
+            memcpy((unsigned char *)bufs[i].start + 2, &synth_seq, sizeof(synth_seq));
+            synth_seq++;
+
+            *buf = bufs[i].start;
+            *size = SYNTH_FRAME_SIZE;
+            *index = i;
+            return 0;
+        }
+
         memset(&vbuf, 0, sizeof(vbuf));
         vbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         vbuf.memory = V4L2_MEMORY_MMAP;
@@ -212,6 +342,11 @@ int camera_eqbuf(int fd, unsigned int index)
         return -1;
     }
 
+    if (fd == synth_fd) {
+        synth_queued[index] = 1;
+        return 0;
+    }
+
     struct v4l2_buffer vbuf = {};
     vbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     vbuf.memory = V4L2_MEMORY_MMAP;
@@ -226,6 +361,11 @@ int camera_eqbuf(int fd, unsigned int index)
 
 int camera_stop(int fd)
 {
+    if (fd == synth_fd) {
+        struct itimerspec its = {};
+        return timerfd_settime(fd, 0, &its, nullptr);
+    }
+
     enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     if (ioctl(fd, VIDIOC_STREAMOFF, &type) == -1) {
         perror("VIDIOC_STREAMOFF");
@@ -236,6 +376,15 @@ int camera_stop(int fd)
 
 int camera_exit(int fd)
 {
+    if (fd == synth_fd) {
+        for (unsigned int i = 0; i < REQBUFS_COUNT; ++i) {
+            free(bufs[i].start);
+            bufs[i].start = MAP_FAILED;
+        }
+        synth_fd = -1;
+        return close(fd);
+    }
+
     // 尝试出队所有仍在队列中的缓冲区（非必须，但更干净）
     struct v4l2_buffer vbuf = {};
     vbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -21,6 +21,24 @@ extern "C" {
 int camera_init(char *devpath, unsigned int *width, unsigned int *height,
                 unsigned int *size, unsigned int *ismjpeg);
 
+/**
+ * @brief 设备丢失后重新打开，沿用上次协商成功的分辨率和格式（失败时才尝试另一种格式）
+ * @param ismjpeg 输入上次的格式，输出实际协商到的格式：1 MJPEG，0 YUYV
+ * @return 文件描述符（>=0 成功），-1 失败
+ */
+int camera_reopen(char *devpath, unsigned int *width, unsigned int *height,
+                  unsigned int *size, unsigned int *ismjpeg);
+
+/**
+ * @brief 设备对应的文件节点（用于监视拔插），没有时返回 NULL
+ */
+const char *camera_node_path(const char *devpath);
+
+/**
+ * @brief 设置 camera_dqbuf 等待一帧的超时（默认 2000ms），超时返回 -1 且 errno 为 ETIMEDOUT
+ */
+void camera_set_timeout(int timeout_ms);
+
 /**
  * @brief 启动视频流
  */
@@ -0,0 +1,131 @@
+// client.cpp
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+extern "C" {
+#include "trace.h"
+}
+#include "client.h"
+
+static void client_start(Client &c, FramePtr msg)
+{
+    c.cur = std::move(msg);
+    c.off = 0;
+    c.start_ns = trace_now_ns();
+    proto_encode_header(c.hdr, c.cur->type, (uint32_t)c.cur->data.size());
+}
+
+void client_post_frame(Client &c, const FramePtr &frame)
+{
+    if (c.cur)
+        c.next = frame;
+    else
+        client_start(c, frame);
+}
+
+void client_post_ctrl(Client &c, const FramePtr &msg)
+{
+    if (!c.cur) {
+        client_start(c, msg);
+        return;
+    }
+    if (c.ctrl.size() >= MAX_CTRL_QUEUE)
+        c.ctrl.pop_front();
+    c.ctrl.push_back(msg);
+}
+
+void client_reply(Client &c, const std::string &text)
+{
+    client_post_ctrl(c, make_message(PROTO_TEXT, text.data(), text.size()));
+}
+
+int client_flush(Client &c)
+{
+    while (c.cur) {
+        const std::vector<unsigned char> &data = c.cur->data;
+        struct iovec iov[2];
+        int n = 0;
+        if (c.off < PROTO_HDR_LEN) {
+            iov[n].iov_base = c.hdr + c.off;
+            iov[n++].iov_len = PROTO_HDR_LEN - c.off;
+            iov[n].iov_base = const_cast<unsigned char *>(data.data());
+            iov[n++].iov_len = data.size();
+        } else {
+            iov[n].iov_base = const_cast<unsigned char *>(data.data()) + (c.off - PROTO_HDR_LEN);
+            iov[n++].iov_len = data.size() - (c.off - PROTO_HDR_LEN);
+        }
+
+        struct msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        ssize_t ret = sendmsg(c.fd, &msg, MSG_NOSIGNAL);
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            perror("send image");
+            return -1;
+        }
+
+        c.off += ret;
+        if (c.off == PROTO_HDR_LEN + data.size()) {
+            if (c.cur->type == PROTO_IMAGE)
+                trace_complete("send", c.start_ns, c.fd);
+            c.cur.reset();
+            if (!c.ctrl.empty()) {
+                FramePtr msg = std::move(c.ctrl.front());
+                c.ctrl.pop_front();
+                client_start(c, std::move(msg));
+            } else if (c.next) {
+                FramePtr next = std::move(c.next);
+                c.next.reset();
+                client_start(c, std::move(next));
+            }
+        }
+    }
+    return 0;
+}
+
+int client_recv(Client &c, const std::function<void(const char *)> &on_line)
+{
+    char recv_buffer[CLIENT_RECV_SIZE];
+    int ret = recv(c.fd, recv_buffer, CLIENT_RECV_SIZE - 1, 0);
+    if (ret == 0)
+        return -1;
+    if (ret < 0)
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+
+    recv_buffer[ret] = '\0'; // ✅ 确保字符串结尾
+
+    // 兼容旧客户端：从未发过换行的客户端一次 send 一条命令
+    if (!c.lines && !memchr(recv_buffer, '\n', ret) && !memchr(recv_buffer, '\r', ret)) {
+        on_line(recv_buffer);
+        return 0;
+    }
+    c.lines = true;
+
+    // 按行解析：'\r' 或 '\n' 结束一条命令，最后不完整的部分留到下次
+    for (int i = 0; i < ret; ++i) {
+        char ch = recv_buffer[i];
+        if (ch == '\r' || ch == '\n') {
+            if (!c.overlong && !c.partial.empty())
+                on_line(c.partial.c_str());
+            c.partial.clear();
+            c.overlong = false;
+        } else if (c.overlong) {
+            continue;
+        } else if (c.partial.size() >= CLIENT_LINE_MAX) {
+            std::fprintf(stderr, "client %d: command longer than %d bytes dropped\n",
+                         c.fd, CLIENT_LINE_MAX);
+            c.partial.clear();
+            c.overlong = true;
+        } else {
+            c.partial += ch;
+        }
+    }
+    return 0;
+}
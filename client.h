@@ -0,0 +1,56 @@
+// client.h
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include "proto.h"
+}
+#include "frame.h"
+#include "playback.h"
+
+#define CLIENT_RECV_SIZE 1024   // 一次读取的命令字节数
+#define CLIENT_LINE_MAX  1024   // 单条命令上限，超过时丢弃这一行
+#define MAX_CTRL_QUEUE   64     // 每个客户端待发的传感器/文本消息上限
+
+/*
+ * 网络线程中的一个客户端连接：命令按行读取，消息非阻塞发送。
+ * 每个客户端最多持有一条消息在发送、一帧图像待发送，
+ * 传感器/文本消息排在图像之前；慢客户端只会丢帧。
+ */
+struct Client {
+    int fd = -1;
+    int source = 0;             // 订阅的视频源（中继模式下即上游站点）
+    bool sensors = false;       // 是否订阅传感器流
+    bool status = false;        // 是否接收广播的状态文本（旧客户端只认图像头，不能发）
+    FramePtr cur;               // 正在发送的消息
+    FramePtr next;              // 发送完成后接着发的最新帧（更旧的被丢弃）
+    std::deque<FramePtr> ctrl;  // 待发的传感器/文本消息，优先于图像
+    std::unique_ptr<Playback> play; // 非空时发送录像回放而不是直播帧
+    size_t off = 0;             // cur 已发送字节数（含消息头）
+    uint64_t start_ns = 0;
+    char hdr[PROTO_HDR_LEN];
+    bool lines = false;         // 发过换行：按行解析；否则沿用旧协议，一次 recv 即一条命令
+    std::string partial;        // 按行解析时尚未收到换行的半条命令
+    bool overlong = false;      // 当前行超过 CLIENT_LINE_MAX，丢弃到换行为止
+};
+
+// 投递一帧图像：空闲则立即开始，否则替换待发帧
+void client_post_frame(Client &c, const FramePtr &frame);
+
+// 投递一条小消息：在当前消息发完后、下一帧图像之前发送
+void client_post_ctrl(Client &c, const FramePtr &msg);
+
+void client_reply(Client &c, const std::string &text);
+
+// 非阻塞发送，直到发完或 EAGAIN；返回 -1 表示连接已失效
+int client_flush(Client &c);
+
+// 读取一次并对每条完整的命令回调（跨多次 recv 的命令会拼接）；返回 -1 表示连接关闭
+int client_recv(Client &c, const std::function<void(const char *)> &on_line);
+
+#endif // CLIENT_H
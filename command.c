@@ -0,0 +1,21 @@
+// command.c
+#include <string.h>
+
+#include "command.h"
+
+static const struct command commands[] = {
+    { "wind_on",      {0x21, 0x01, 0x09, 0x01, 0x57, 0x40, 0x2c, 0x66, 0x00, 0x31, 0x90}, 11 },
+    { "wind_off",     {0x21, 0x01, 0x09, 0x01, 0x57, 0x40, 0x2c, 0x66, 0x00, 0x30, 0x97}, 11 },
+    { "lock_on",      {0x21, 0x01, 0x09, 0x01, 0x57, 0x40, 0x2e, 0x72, 0x00, 0x31, 0xb5}, 11 },
+    { "lock_off",     {0x21, 0x01, 0x09, 0x01, 0x57, 0x40, 0x2e, 0x72, 0x00, 0x30, 0xb2}, 11 },
+    { "get_temp_val", {0}, 0 },
+};
+
+const struct command *command_find(const char *name)
+{
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i) {
+        if (strcmp(name, commands[i].name) == 0)
+            return &commands[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,34 @@
+// command.h
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/*
+ * 客户端命令表：控制类命令对应一帧固定的 ZigBee 串口帧，
+ * 查询类命令（frame_len 为 0）由调用者自行处理。
+ */
+
+#define COMMAND_FRAME_MAX 16
+
+struct command {
+    const char *name;
+    unsigned char frame[COMMAND_FRAME_MAX];
+    size_t frame_len;
+};
+
+/**
+ * @brief 按名字查找命令
+ * @return 命令描述，未知命令返回 NULL
+ */
+const struct command *command_find(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_H
@@ -0,0 +1,114 @@
+// dispatch.cpp
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include "trace.h"    // trace_dump_async
+}
+#include "playback.h" // Playback
+#include "dispatch.h"
+
+// 录像命令：archive 查询范围，play <unix_ms> [speed] 开始回放，live 回到直播
+static void playback_command(Client &c, NetState &st, const DispatchEnv &env, const char *cmd)
+{
+    if (!env.archive) {
+        client_reply(c, "archive disabled");
+        return;
+    }
+
+    if (strcmp(cmd, "archive") == 0) {
+        uint64_t first, last;
+        if (archive_range(env.archive, &first, &last) == -1)
+            client_reply(c, "archive empty");
+        else
+            client_reply(c, "archive " + std::to_string(first) + " " + std::to_string(last));
+    }
+    else if (strcmp(cmd, "live") == 0) {
+        c.play.reset();
+        c.next.reset();
+        client_reply(c, "live");
+        if (st.latest[c.source])
+            client_post_frame(c, st.latest[c.source]);
+    }
+    else {
+        char *end;
+        unsigned long long from = std::strtoull(cmd + 5, &end, 10);
+        double speed = std::strtod(end, nullptr);
+        if (end == cmd + 5) {
+            client_reply(c, "usage: play <unix_ms> [speed]");
+            return;
+        }
+
+        c.play.reset();
+        std::unique_ptr<Playback> play(new Playback(env.archive, from, speed, *env.pool));
+        if (play->start() == -1) {
+            client_reply(c, "playback failed");
+            return;
+        }
+        c.play = std::move(play);
+        c.next.reset();
+        client_reply(c, "playback " + std::to_string(from));
+    }
+}
+
+// 网络层命令（视频源切换、订阅等），其余交给串口或转发上游
+void client_command(Client &c, NetState &st, const DispatchEnv &env, const char *cmd)
+{
+    const std::vector<std::unique_ptr<Upstream> > &upstreams = *env.upstreams;
+
+    // 发过这些命令的客户端认识带类型的消息头，之后也接收状态通知
+    if (strcmp(cmd, "subscribe_sensors") == 0 || strcmp(cmd, "subscribe_status") == 0 ||
+        strcmp(cmd, "sites") == 0 || strncmp(cmd, "site ", 5) == 0 ||
+        strncmp(cmd, "play ", 5) == 0 || strcmp(cmd, "live") == 0 || strcmp(cmd, "archive") == 0)
+        c.status = true;
+
+    if (strcmp(cmd, "subscribe_status") == 0) {
+    }
+    else if (strcmp(cmd, "subscribe_sensors") == 0) {
+        c.sensors = true;
+        for (auto &kv : st.sensors[c.source])
+            client_post_ctrl(c, kv.second);
+    }
+    else if (strcmp(cmd, "sites") == 0) {
+        std::string text;
+        for (size_t i = 0; i < env.nsources; ++i) {
+            text += std::to_string(i) + " ";
+            if (upstreams.empty())
+                text += "local\n";
+            else
+                text += upstreams[i]->name() + (upstreams[i]->connected() ? " up\n" : " down\n");
+        }
+        client_reply(c, text);
+    }
+    else if (strncmp(cmd, "site ", 5) == 0) {
+        int site = std::atoi(cmd + 5);
+        if (site < 0 || site >= (int)env.nsources) {
+            client_reply(c, "no such site");
+            return;
+        }
+        c.source = site;
+        c.next.reset();
+        client_reply(c, "site " + std::to_string(site));
+        if (c.sensors) {
+            for (auto &kv : st.sensors[site])
+                client_post_ctrl(c, kv.second);
+        }
+        if (st.latest[site])
+            client_post_frame(c, st.latest[site]);
+    }
+    else if (strncmp(cmd, "play ", 5) == 0 || strcmp(cmd, "live") == 0 ||
+             strcmp(cmd, "archive") == 0) {
+        playback_command(c, st, env, cmd);
+    }
+    else if (strcmp(cmd, "dump_trace") == 0) {
+        trace_dump_async(nullptr);   // 不在网络线程上格式化和写文件
+    }
+    else if (!upstreams.empty()) {
+        if (upstreams[c.source]->send_command(cmd) == -1 && c.status)
+            client_reply(c, "upstream " + upstreams[c.source]->name() + " not connected");
+    }
+    else if (env.local) {
+        env.local(cmd);
+    }
+}
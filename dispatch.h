@@ -0,0 +1,39 @@
+// dispatch.h
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <map>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include "archive.h"
+}
+#include "client.h"
+#include "frame.h"
+#include "relay.h"
+
+/*
+ * 网络线程的客户端命令分发：视频源切换、订阅、录像回放在网络线程内处理，
+ * 其余命令在中继模式下转发给上游，本地模式交给串口。
+ */
+
+// 网络线程私有状态：每个视频源的最新帧和各节点最新读数，供新订阅者立即获取
+struct NetState {
+    std::vector<FramePtr> latest;
+    std::vector<std::map<unsigned short, FramePtr> > sensors;
+};
+
+// 分发命令用到的服务端对象，网络线程启动时填好
+struct DispatchEnv {
+    size_t nsources;                                            // 视频源数
+    const std::vector<std::unique_ptr<Upstream> > *upstreams;   // 中继模式的上游，本地模式为空
+    struct archive *archive;                                    // 为空时录像命令回复 archive disabled
+    FramePool *pool;                                            // 回放帧的来源
+    void (*local)(const char *cmd);                             // 本地模式下的串口命令
+};
+
+// 处理客户端的一条命令
+void client_command(Client &c, NetState &st, const DispatchEnv &env, const char *cmd);
+
+#endif // DISPATCH_H
@@ -0,0 +1,114 @@
+// fbus_reader.c —— 帧总线示例读者：统计帧率、丢帧和延迟，可选每秒保存一帧
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "framebus.h"
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = FBUS_NAME_DEFAULT;
+    const char *outpath = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:")) != -1) {
+        switch (opt) {
+        case 'n': name = optarg; break;
+        case 'o': outpath = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-n shm_name] [-o snapshot.jpg]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    struct fbus *bus = fbus_open(name);
+    if (!bus)
+        return -1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    const struct fbus_header *info = fbus_info(bus);
+    printf("%s: %ux%u %s, %u slots x %u bytes\n", name, info->width, info->height,
+           info->ismjpeg ? "MJPEG" : "YUYV", info->slot_count, info->slot_size);
+
+    // 从最新帧开始读
+    uint64_t next = info->write_seq ? info->write_seq - 1 : 0;
+    uint64_t frames = 0, skipped = 0, torn = 0, latency_us = 0;
+    uint64_t window_start = fbus_now_us();
+    int saved = 0;
+
+    while (!g_stop) {
+        int64_t ret = fbus_wait(bus, &next, 1000);
+        if (ret == FBUS_CLOSED) {
+            // 发布者退出或按新帧尺寸重建了总线：重新打开
+            printf("%s closed by publisher, reopening\n", name);
+            fbus_close(bus);
+            bus = NULL;
+            while (!g_stop && !(bus = fbus_open(name)))
+                sleep(1);
+            if (!bus)
+                break;
+            info = fbus_info(bus);
+            printf("%s: %ux%u %s, %u slots x %u bytes\n", name, info->width, info->height,
+                   info->ismjpeg ? "MJPEG" : "YUYV", info->slot_count, info->slot_size);
+            next = info->write_seq ? info->write_seq - 1 : 0;
+            continue;
+        }
+        if (ret < 0)
+            continue;   // 超时：发布者可能暂停
+        skipped += (uint64_t)ret;
+
+        struct fbus_frame frame;
+        if (fbus_read_begin(bus, next, &frame) == -1) {
+            torn++;
+            next++;
+            continue;
+        }
+
+        // 直接在共享内存上处理数据，结束后校验
+        uint64_t now = fbus_now_us();
+        if (outpath && !saved) {
+            int fd = open(outpath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if (fd != -1) {
+                if (write(fd, frame.data, frame.len) != (ssize_t)frame.len)
+                    perror("write snapshot");
+                close(fd);
+            }
+        }
+
+        if (fbus_read_end(bus, &frame) == -1) {
+            torn++;   // 读取期间被覆盖，本帧作废
+        } else {
+            frames++;
+            latency_us += now - frame.ts_us;
+            if (outpath)
+                saved = 1;
+        }
+        next++;
+
+        if (now - window_start >= 1000000) {
+            printf("fps %llu, skipped %llu, torn %llu, avg latency %llu us\n",
+                   (unsigned long long)frames, (unsigned long long)skipped,
+                   (unsigned long long)torn,
+                   (unsigned long long)(frames ? latency_us / frames : 0));
+            frames = skipped = torn = latency_us = 0;
+            window_start = now;
+            saved = 0;
+        }
+    }
+
+    fbus_close(bus);
+    return 0;
+}
@@ -0,0 +1,143 @@
+// frame.cpp
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "frame.h"
+
+FramePtr make_message(int type, const void *data, size_t len)
+{
+    std::shared_ptr<Frame> f = std::make_shared<Frame>();
+    f->data.assign((const unsigned char *)data, (const unsigned char *)data + len);
+    f->type = type;
+    return f;
+}
+
+FramePtr FramePool::make(const void *data, size_t len, uint64_t ts_us, uint64_t seq)
+{
+    std::shared_ptr<Frame> f = get(len);
+    std::memcpy(f->data.data(), data, len);
+    f->ts_us = ts_us;
+    f->seq = seq;
+    return f;
+}
+
+std::shared_ptr<Frame> FramePool::get(size_t len)
+{
+    Frame *f = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (!free_.empty()) {
+            f = free_.back();
+            free_.pop_back();
+        }
+    }
+    if (!f)
+        f = new Frame;
+
+    // resize 不会缩小容量，复用的缓冲区只在帧变大时重新分配
+    f->data.resize(len);
+    f->ts_us = 0;
+    f->seq = 0;
+    f->type = 0;
+
+    return std::shared_ptr<Frame>(f, [this](Frame *p) { recycle(p); });
+}
+
+void FramePool::recycle(Frame *f)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (free_.size() < max_free_) {
+            free_.push_back(f);
+            return;
+        }
+    }
+    delete f;
+}
+
+FrameMailbox::FrameMailbox()
+{
+    efd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd_ == -1)
+        perror("eventfd");
+}
+
+FrameMailbox::~FrameMailbox()
+{
+    if (efd_ != -1)
+        close(efd_);
+}
+
+void FrameMailbox::post(FramePtr f)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        latest_ = std::move(f);
+    }
+    uint64_t one = 1;
+    if (write(efd_, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+        perror("mailbox: eventfd write");
+}
+
+FramePtr FrameMailbox::take()
+{
+    uint64_t cnt;
+    if (read(efd_, &cnt, sizeof(cnt)) == -1 && errno != EAGAIN)
+        perror("mailbox: eventfd read");
+
+    std::lock_guard<std::mutex> guard(lock_);
+    FramePtr f = std::move(latest_);
+    latest_.reset();
+    return f;
+}
+
+FramePtr FrameMailbox::wait(int timeout_ms)
+{
+    struct pollfd pfd = { efd_, POLLIN, 0 };
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret <= 0)
+        return FramePtr();
+    return take();
+}
+
+MessageQueue::MessageQueue(size_t cap) : cap_(cap)
+{
+    efd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd_ == -1)
+        perror("eventfd");
+}
+
+MessageQueue::~MessageQueue()
+{
+    if (efd_ != -1)
+        close(efd_);
+}
+
+void MessageQueue::post(int source, FramePtr msg)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (q_.size() >= cap_)
+            q_.pop_front();
+        q_.push_back(std::make_pair(source, std::move(msg)));
+    }
+    uint64_t one = 1;
+    if (write(efd_, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+        perror("msgqueue: eventfd write");
+}
+
+std::deque<std::pair<int, FramePtr> > MessageQueue::take_all()
+{
+    uint64_t cnt;
+    if (read(efd_, &cnt, sizeof(cnt)) == -1 && errno != EAGAIN)
+        perror("msgqueue: eventfd read");
+
+    std::deque<std::pair<int, FramePtr> > out;
+    std::lock_guard<std::mutex> guard(lock_);
+    out.swap(q_);
+    return out;
+}
@@ -0,0 +1,103 @@
+// frame.h
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// 一帧图像：采集线程复制一次，各消费线程共享只读引用
+// 同一结构也承载发给客户端的传感器/文本消息（type 见 proto.h）
+struct Frame {
+    std::vector<unsigned char> data;
+    uint64_t ts_us = 0;     // CLOCK_MONOTONIC 微秒
+    uint64_t seq = 0;       // 采集序号
+    int type = 0;           // PROTO_IMAGE / PROTO_SENSOR / PROTO_TEXT
+};
+
+typedef std::shared_ptr<const Frame> FramePtr;
+
+// 生成一条小消息（传感器/文本），不经过帧缓冲池
+FramePtr make_message(int type, const void *data, size_t len);
+
+/*
+ * 帧缓冲池：引用计数归零时缓冲区回到池中复用，
+ * 稳定运行后采集路径上不再有 malloc 和缺页。
+ */
+class FramePool {
+public:
+    explicit FramePool(size_t max_free = 16) : max_free_(max_free) {}
+
+    // 复制 len 字节生成一帧
+    FramePtr make(const void *data, size_t len, uint64_t ts_us, uint64_t seq);
+
+    // 取一个 len 字节的可写帧，由调用者直接填充（如从 socket 读入）
+    std::shared_ptr<Frame> get(size_t len);
+
+private:
+    void recycle(Frame *f);
+
+    std::mutex lock_;
+    std::vector<Frame *> free_;
+    size_t max_free_;
+};
+
+/*
+ * 单槽"最新帧"信箱：写者覆盖未取走的旧帧（慢消费者自动丢帧），
+ * 通过 eventfd 唤醒，可直接放进 poll()。
+ */
+class FrameMailbox {
+public:
+    FrameMailbox();
+    ~FrameMailbox();
+
+    int fd() const { return efd_; }
+
+    void post(FramePtr f);
+
+    // 取走最新帧（可能为空），同时清除 eventfd 计数
+    FramePtr take();
+
+    // 阻塞等待新帧，超时返回空
+    FramePtr wait(int timeout_ms);
+
+private:
+    FrameMailbox(const FrameMailbox &) = delete;
+    FrameMailbox &operator=(const FrameMailbox &) = delete;
+
+    int efd_;
+    std::mutex lock_;
+    FramePtr latest_;
+};
+
+/*
+ * 小消息队列（传感器读数、状态文本）：多生产者、单消费者，
+ * 每条消息带来源编号；满时丢弃最旧的消息。同样用 eventfd 唤醒。
+ */
+class MessageQueue {
+public:
+    explicit MessageQueue(size_t cap = 256);
+    ~MessageQueue();
+
+    int fd() const { return efd_; }
+
+    void post(int source, FramePtr msg);
+
+    // 取走全部消息
+    std::deque<std::pair<int, FramePtr> > take_all();
+
+private:
+    MessageQueue(const MessageQueue &) = delete;
+    MessageQueue &operator=(const MessageQueue &) = delete;
+
+    int efd_;
+    size_t cap_;
+    std::mutex lock_;
+    std::deque<std::pair<int, FramePtr> > q_;
+};
+
+#endif // FRAME_H
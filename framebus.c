@@ -0,0 +1,352 @@
+// framebus.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "framebus.h"
+
+struct fbus {
+    int fd;
+    int owner;                  // 1：发布者，负责 shm_unlink
+    char name[64];
+    struct fbus_header *hdr;    // 读者只读映射
+    struct fbus_waitq *wq;
+    unsigned char *slots;
+    size_t slots_len;
+
+    // 私有副本：发布时和读者定位槽位时只用这些，不回读共享内存
+    uint32_t slot_count;
+    uint32_t slot_stride;
+    uint32_t slot_size;
+    uint64_t write_seq;         // 仅发布者使用
+};
+
+uint64_t fbus_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static long futex(uint32_t *uaddr, int op, uint32_t val, const struct timespec *timeout)
+{
+    // 共享内存跨进程使用，不能用 FUTEX_PRIVATE_FLAG
+    return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+static struct fbus_slot *slot_of(const struct fbus *bus, uint64_t frame_no)
+{
+    uint32_t idx = (uint32_t)(frame_no % bus->slot_count);
+    return (struct fbus_slot *)(bus->slots + (size_t)idx * bus->slot_stride);
+}
+
+// 同名对象已存在时：仍被发布者锁定返回 -1（errno 为 EBUSY），遗留对象删除后返回 0
+static int remove_stale(const char *name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1)
+        return errno == ENOENT ? 0 : -1;
+
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        if (errno == EWOULDBLOCK) {
+            struct fbus_header hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr))
+                hdr.owner_pid = 0;
+            fprintf(stderr, "fbus: %s is in use by publisher pid %u\n", name, hdr.owner_pid);
+            errno = EBUSY;
+        }
+        close(fd);
+        return -1;
+    }
+
+    shm_unlink(name);
+    close(fd);      // 同时释放锁
+    return 0;
+}
+
+struct fbus *fbus_create(const char *name, unsigned int slot_count, size_t slot_size,
+                         unsigned int mode)
+{
+    if (!name || slot_count == 0 || slot_size == 0 || slot_size > UINT32_MAX / 2) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct fbus *bus = calloc(1, sizeof(*bus));
+    if (!bus)
+        return NULL;
+    snprintf(bus->name, sizeof(bus->name), "%s", name);
+    bus->owner = 1;
+
+    // 槽位按 64 字节对齐，避免相邻槽位的序号共享缓存行
+    uint32_t stride = (uint32_t)((sizeof(struct fbus_slot) + slot_size + 63) & ~(size_t)63);
+    bus->slots_len = (size_t)stride * slot_count;
+    bus->slot_count = slot_count;
+    bus->slot_stride = stride;
+    bus->slot_size = (uint32_t)slot_size;
+
+    bus->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, mode & 0666);
+    if (bus->fd == -1 && errno == EEXIST) {
+        if (remove_stale(name) == -1) {
+            int err = errno;
+            if (err != EBUSY)
+                perror("fbus: open existing");
+            free(bus);
+            errno = err;
+            return NULL;
+        }
+        bus->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, mode & 0666);
+    }
+    if (bus->fd == -1) {
+        perror("fbus: shm_open");
+        free(bus);
+        return NULL;
+    }
+    // 锁随 fd 一直持有到 fbus_destroy 或进程退出
+    if (flock(bus->fd, LOCK_EX | LOCK_NB) == -1) {
+        perror("fbus: flock");
+        goto fail;
+    }
+    fchmod(bus->fd, mode & 0666);   // 不受 umask 影响
+
+    if (ftruncate(bus->fd, FBUS_SLOTS_OFFSET + bus->slots_len) == -1) {
+        perror("fbus: ftruncate");
+        goto fail;
+    }
+
+    void *map = mmap(NULL, FBUS_SLOTS_OFFSET + bus->slots_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, bus->fd, 0);
+    if (map == MAP_FAILED) {
+        perror("fbus: mmap");
+        goto fail;
+    }
+    bus->hdr = map;
+    bus->wq = (struct fbus_waitq *)((unsigned char *)map + FBUS_WAITQ_OFFSET);
+    bus->slots = (unsigned char *)map + FBUS_SLOTS_OFFSET;
+
+    bus->hdr->version = FBUS_VERSION;
+    bus->hdr->slot_count = slot_count;
+    bus->hdr->slot_stride = stride;
+    bus->hdr->slot_size = (uint32_t)slot_size;
+    bus->hdr->owner_pid = (uint32_t)getpid();
+    // magic 最后写入，读者看到 magic 即说明头部已初始化
+    __atomic_store_n(&bus->hdr->magic, FBUS_MAGIC, __ATOMIC_RELEASE);
+    return bus;
+
+fail:
+    close(bus->fd);
+    shm_unlink(name);
+    free(bus);
+    return NULL;
+}
+
+void fbus_set_format(struct fbus *bus, unsigned int width, unsigned int height,
+                     unsigned int ismjpeg)
+{
+    bus->hdr->width = width;
+    bus->hdr->height = height;
+    bus->hdr->ismjpeg = ismjpeg;
+}
+
+int64_t fbus_publish(struct fbus *bus, const void *data, size_t len, uint64_t ts_us)
+{
+    if (len > bus->slot_size)
+        return -1;
+
+    uint64_t n = bus->write_seq++;
+    struct fbus_slot *slot = slot_of(bus, n);
+
+    // seqlock 写端：奇数序号 -> 写数据 -> 偶数序号
+    __atomic_store_n(&slot->seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(slot->data, data, len);
+    slot->frame_no = n;
+    slot->ts_us = ts_us;
+    slot->len = (uint32_t)len;
+    __atomic_store_n(&slot->seq, 2 * (n + 1), __ATOMIC_RELEASE);
+
+    __atomic_store_n(&bus->hdr->write_seq, n + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&bus->wq->futex, (uint32_t)(n + 1), __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&bus->wq->waiters, __ATOMIC_SEQ_CST))
+        futex(&bus->wq->futex, FUTEX_WAKE, INT_MAX, NULL);
+
+    return (int64_t)n;
+}
+
+void fbus_destroy(struct fbus *bus)
+{
+    if (!bus)
+        return;
+    if (bus->owner) {
+        // 先通知再删除：已打开的读者仍映射着旧对象，否则会一直等下去
+        __atomic_store_n(&bus->hdr->closed, 1, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&bus->wq->futex, 1, __ATOMIC_SEQ_CST);
+        futex(&bus->wq->futex, FUTEX_WAKE, INT_MAX, NULL);
+    }
+    munmap(bus->hdr, FBUS_SLOTS_OFFSET + bus->slots_len);
+    close(bus->fd);
+    if (bus->owner)
+        shm_unlink(bus->name);
+    free(bus);
+}
+
+struct fbus *fbus_open(const char *name)
+{
+    struct fbus *bus = calloc(1, sizeof(*bus));
+    if (!bus)
+        return NULL;
+    snprintf(bus->name, sizeof(bus->name), "%s", name);
+
+    bus->fd = shm_open(name, O_RDWR, 0);
+    if (bus->fd == -1) {
+        perror("fbus: shm_open");
+        free(bus);
+        return NULL;
+    }
+
+    // 头部和槽位只读映射，只有等待页可写
+    void *hdr = mmap(NULL, FBUS_HEADER_SIZE, PROT_READ, MAP_SHARED, bus->fd, 0);
+    if (hdr == MAP_FAILED) {
+        perror("fbus: mmap header");
+        goto fail;
+    }
+    bus->hdr = hdr;
+
+    if (__atomic_load_n(&bus->hdr->magic, __ATOMIC_ACQUIRE) != FBUS_MAGIC ||
+        bus->hdr->version != FBUS_VERSION) {
+        fprintf(stderr, "fbus: %s is not a frame bus (or version mismatch)\n", name);
+        goto fail_hdr;
+    }
+
+    // 槽位参数取一次私有副本并与对象大小核对，之后不再回读
+    bus->slot_count = bus->hdr->slot_count;
+    bus->slot_stride = bus->hdr->slot_stride;
+    bus->slot_size = bus->hdr->slot_size;
+    bus->slots_len = (size_t)bus->slot_stride * bus->slot_count;
+
+    struct stat st;
+    if (fstat(bus->fd, &st) == -1 || bus->slot_count == 0 ||
+        (uint64_t)bus->slot_stride < sizeof(struct fbus_slot) + (uint64_t)bus->slot_size ||
+        (uint64_t)st.st_size < FBUS_SLOTS_OFFSET + (uint64_t)bus->slots_len) {
+        fprintf(stderr, "fbus: %s has an inconsistent layout\n", name);
+        goto fail_hdr;
+    }
+
+    void *wq = mmap(NULL, FBUS_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, bus->fd,
+                    FBUS_WAITQ_OFFSET);
+    if (wq == MAP_FAILED) {
+        perror("fbus: mmap wait queue");
+        goto fail_hdr;
+    }
+    bus->wq = wq;
+
+    void *slots = mmap(NULL, bus->slots_len, PROT_READ, MAP_SHARED, bus->fd, FBUS_SLOTS_OFFSET);
+    if (slots == MAP_FAILED) {
+        perror("fbus: mmap slots");
+        munmap(wq, FBUS_HEADER_SIZE);
+        goto fail_hdr;
+    }
+    bus->slots = slots;
+    return bus;
+
+fail_hdr:
+    munmap(hdr, FBUS_HEADER_SIZE);
+
+fail:
+    close(bus->fd);
+    free(bus);
+    return NULL;
+}
+
+const struct fbus_header *fbus_info(const struct fbus *bus)
+{
+    return bus->hdr;
+}
+
+int64_t fbus_wait(struct fbus *bus, uint64_t *next, int timeout_ms)
+{
+    const struct fbus_header *hdr = bus->hdr;
+    struct fbus_waitq *wq = bus->wq;
+    uint64_t deadline = timeout_ms >= 0 ? fbus_now_us() + (uint64_t)timeout_ms * 1000 : 0;
+
+    for (;;) {
+        if (__atomic_load_n(&hdr->closed, __ATOMIC_ACQUIRE))
+            return FBUS_CLOSED;
+        uint64_t ws = __atomic_load_n(&hdr->write_seq, __ATOMIC_ACQUIRE);
+        if (ws > *next) {
+            // 落后超过一圈：旧帧已被覆盖，直接跳到最新帧
+            if (ws - *next > bus->slot_count) {
+                int64_t skipped = (int64_t)(ws - 1 - *next);
+                *next = ws - 1;
+                return skipped;
+            }
+            return 0;
+        }
+
+        struct timespec ts, *pts = NULL;
+        if (timeout_ms >= 0) {
+            uint64_t now = fbus_now_us();
+            if (now >= deadline)
+                return -1;
+            ts.tv_sec = (deadline - now) / 1000000;
+            ts.tv_nsec = ((deadline - now) % 1000000) * 1000;
+            pts = &ts;
+        }
+
+        // 先登记等待者再复查，与发布者的 "写 futex -> 读 waiters" 配对，不会丢唤醒
+        __atomic_add_fetch(&wq->waiters, 1, __ATOMIC_SEQ_CST);
+        uint32_t val = __atomic_load_n(&wq->futex, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&hdr->write_seq, __ATOMIC_SEQ_CST) <= *next &&
+            !__atomic_load_n(&hdr->closed, __ATOMIC_SEQ_CST))
+            futex(&wq->futex, FUTEX_WAIT, val, pts);
+        __atomic_sub_fetch(&wq->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+int fbus_read_begin(struct fbus *bus, uint64_t frame_no, struct fbus_frame *frame)
+{
+    const struct fbus_slot *slot = slot_of(bus, frame_no);
+
+    uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq != 2 * (frame_no + 1))
+        return -1;
+
+    frame->seq = seq;
+    frame->frame_no = frame_no;
+    frame->ts_us = slot->ts_us;
+    frame->len = slot->len;
+    if (frame->len > bus->slot_size)
+        frame->len = bus->slot_size;   // 读到撕裂的长度，由 read_end 判定无效
+    frame->data = slot->data;
+    return 0;
+}
+
+int fbus_read_end(struct fbus *bus, const struct fbus_frame *frame)
+{
+    const struct fbus_slot *slot = slot_of(bus, frame->frame_no);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == frame->seq ? 0 : -1;
+}
+
+void fbus_close(struct fbus *bus)
+{
+    if (!bus)
+        return;
+    munmap(bus->slots, bus->slots_len);
+    munmap(bus->wq, FBUS_HEADER_SIZE);
+    munmap(bus->hdr, FBUS_HEADER_SIZE);
+    close(bus->fd);
+    free(bus);
+}
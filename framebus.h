@@ -0,0 +1,152 @@
+// framebus.h
+#ifndef FRAMEBUS_H
+#define FRAMEBUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 本机共享内存帧总线
+ *
+ * 采集循环把每帧写入 POSIX 共享内存中的环形槽位，本机任意数量的读者进程
+ * 直接在映射内存上读取（零拷贝）。每个槽位带 seqlock 序号：奇数表示正在写入，
+ * 读者在读完后校验序号未变即可确认数据完整。发布者从不等待读者，
+ * 读者落后超过槽位数时跳到最新帧。读者追上后通过 futex 等待，
+ * 发布者只在有等待者时才调用 futex 唤醒，正常路径上每帧没有系统调用。
+ *
+ * 共享内存布局：第一页为 struct fbus_header（读者只读映射），
+ * 第二页为 struct fbus_waitq（读者读写映射，只含唤醒字和等待计数），
+ * 之后为 slot_count 个槽位（读者只读映射）。
+ * 发布者只使用自己私有的槽位参数和写序号，共享内存中的内容被篡改
+ * 最多影响读者看到的数据，不会影响发布者。
+ *
+ * 发布者在存活期间对共享内存对象持有 flock 排他锁。同名对象已存在时，
+ * 锁仍被持有说明另一个发布者在运行，fbus_create 拒绝接管；
+ * 否则是异常退出遗留的对象，删除后重建。
+ *
+ * 发布者关闭总线时先置 closed 并唤醒所有等待者，fbus_wait 随即返回
+ * FBUS_CLOSED；读者应 fbus_close 后重新 fbus_open（可能是按新帧尺寸重建的总线）。
+ */
+
+#define FBUS_NAME_DEFAULT "/pserver_frames"
+#define FBUS_MAGIC        0x53554246u   /* "FBUS" */
+#define FBUS_VERSION      3
+#define FBUS_HEADER_SIZE  4096
+#define FBUS_WAITQ_OFFSET FBUS_HEADER_SIZE
+#define FBUS_SLOTS_OFFSET (2 * FBUS_HEADER_SIZE)
+#define FBUS_MODE_DEFAULT 0660          // 同组用户可读；其他用户需 fbus_create 指定
+#define FBUS_CLOSED       (-2)          // fbus_wait：发布者已关闭总线
+
+struct fbus_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_stride;       // 槽位间距（含槽位头）
+    uint32_t slot_size;         // 槽位可容纳的最大帧字节数
+    uint32_t width;
+    uint32_t height;
+    uint32_t ismjpeg;
+    uint64_t write_seq;         // 已发布的帧数，下一帧编号
+    uint32_t owner_pid;         // 发布者进程号（仅用于提示，是否存活以文件锁为准）
+    uint32_t closed;            // 1：发布者已关闭此总线（退出或按新尺寸重建），读者应重新打开
+};
+
+struct fbus_waitq {
+    uint32_t futex;             // 唤醒字：write_seq 的低 32 位
+    uint32_t waiters;           // 正在 futex 上等待的读者数
+};
+
+struct fbus_slot {
+    uint64_t seq;               // seqlock：2*(frame_no+1) 稳定，奇数写入中
+    uint64_t frame_no;
+    uint64_t ts_us;             // CLOCK_MONOTONIC 微秒
+    uint32_t len;
+    uint32_t reserved;
+    unsigned char data[];
+};
+
+/* 读者看到的一帧（data 指向共享内存，仅在 fbus_read_end 校验通过前有效） */
+struct fbus_frame {
+    const unsigned char *data;
+    uint32_t len;
+    uint64_t frame_no;
+    uint64_t ts_us;
+    uint64_t seq;
+};
+
+struct fbus;
+
+/**
+ * @brief 发布者：创建共享内存总线（同名对象是遗留的则重建）
+ * @param name 共享内存名，如 FBUS_NAME_DEFAULT
+ * @param slot_count 槽位数
+ * @param slot_size 单帧最大字节数
+ * @param mode 共享内存对象的访问权限（不受 umask 影响），如 FBUS_MODE_DEFAULT
+ * @return 句柄，失败返回 NULL；同名总线仍有发布者时 errno 为 EBUSY
+ */
+struct fbus *fbus_create(const char *name, unsigned int slot_count, size_t slot_size,
+                         unsigned int mode);
+
+/**
+ * @brief 发布者：记录图像格式，供读者查询
+ */
+void fbus_set_format(struct fbus *bus, unsigned int width, unsigned int height,
+                     unsigned int ismjpeg);
+
+/**
+ * @brief 发布者：发布一帧（从不阻塞）
+ * @return 帧编号，帧过大返回 -1
+ */
+int64_t fbus_publish(struct fbus *bus, const void *data, size_t len, uint64_t ts_us);
+
+/**
+ * @brief 发布者：通知读者总线已关闭，解除映射并删除共享内存
+ */
+void fbus_destroy(struct fbus *bus);
+
+/**
+ * @brief 读者：打开已存在的总线
+ */
+struct fbus *fbus_open(const char *name);
+
+/**
+ * @brief 读者：获取总线头（格式、槽位信息）
+ */
+const struct fbus_header *fbus_info(const struct fbus *bus);
+
+/**
+ * @brief 读者：等待编号 >= *next 的帧可读
+ * @param next 输入期望的帧编号，落后过多时被调整为最新帧
+ * @param timeout_ms 超时毫秒，-1 表示一直等待
+ * @return 跳过的帧数（>=0），超时返回 -1，总线已关闭返回 FBUS_CLOSED
+ */
+int64_t fbus_wait(struct fbus *bus, uint64_t *next, int timeout_ms);
+
+/**
+ * @brief 读者：开始零拷贝读取指定帧
+ * @return 0 成功，-1 该帧尚未发布或已被覆盖
+ */
+int fbus_read_begin(struct fbus *bus, uint64_t frame_no, struct fbus_frame *frame);
+
+/**
+ * @brief 读者：结束读取，校验期间槽位未被覆盖
+ * @return 0 数据完整，-1 读取期间被发布者覆盖（应丢弃）
+ */
+int fbus_read_end(struct fbus *bus, const struct fbus_frame *frame);
+
+/**
+ * @brief 读者：关闭总线
+ */
+void fbus_close(struct fbus *bus);
+
+uint64_t fbus_now_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAMEBUS_H
@@ -0,0 +1,148 @@
+// playback.cpp
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <time.h>
+
+extern "C" {
+#include "proto.h"
+#include "topology.h"
+#include "trace.h"
+}
+#include "playback.h"
+
+#define PLAYBACK_SLEEP_MAX_MS 50    // 等待下一帧时检查停止标志的间隔
+#define PLAYBACK_GAP_MAX_MS   2000  // 相邻两帧时间差超过此值（录像中断或时钟跳变）时重新排期
+
+// 回放线程与 Playback 共享的状态，最后一个持有者释放
+struct Playback::Session {
+    Session(struct archive *a, uint64_t from, double sp, FramePool &p)
+        : archive(a), from_ms(from), speed(sp > 0 ? sp : 1.0), pool(p), stop(false) {}
+
+    void run();
+    void play(struct archive_cursor *cursor);
+
+    struct archive *archive;
+    uint64_t from_ms;
+    double speed;
+    FramePool &pool;
+    FrameMailbox box;
+    std::atomic<bool> stop;
+};
+
+// 仍在运行的回放线程数，drain() 等它归零
+static std::mutex g_running_lock;
+static std::condition_variable g_running_cv;
+static int g_running = 0;
+
+static void running_add(int n)
+{
+    std::lock_guard<std::mutex> guard(g_running_lock);
+    g_running += n;
+    if (g_running == 0)
+        g_running_cv.notify_all();
+}
+
+Playback::Playback(struct archive *a, uint64_t from_ms, double speed, FramePool &pool)
+    : s_(std::make_shared<Session>(a, from_ms, speed, pool))
+{
+}
+
+Playback::~Playback()
+{
+    s_->stop = true;
+    thread_.detach();
+}
+
+int Playback::start()
+{
+    std::shared_ptr<Session> s = s_;
+    running_add(1);
+    if (thread_.start([s] { s->run(); running_add(-1); }) == -1) {
+        running_add(-1);
+        return -1;
+    }
+    return 0;
+}
+
+int Playback::fd() const
+{
+    return s_->box.fd();
+}
+
+FramePtr Playback::take()
+{
+    return s_->box.take();
+}
+
+void Playback::drain()
+{
+    std::unique_lock<std::mutex> guard(g_running_lock);
+    g_running_cv.wait(guard, [] { return g_running == 0; });
+}
+
+void Playback::Session::run()
+{
+    // 由网络线程创建，不继承它的 CPU 绑定和实时优先级
+    topo_apply_default(pthread_self(), "ps-playback");
+    trace_thread_name("playback");
+
+    // 定位要读索引文件，放在回放线程里做，不占用网络线程
+    struct archive_cursor *cursor = archive_seek(archive, from_ms);
+    if (!cursor) {
+        std::string text = "no recording after " + std::to_string(from_ms);
+        box.post(make_message(PROTO_TEXT, text.data(), text.size()));
+        return;
+    }
+    play(cursor);
+    archive_cursor_close(cursor);
+
+    if (!stop) {
+        std::string text = "playback end";
+        box.post(make_message(PROTO_TEXT, text.data(), text.size()));
+    }
+}
+
+void Playback::Session::play(struct archive_cursor *cursor)
+{
+    uint64_t first_ts = 0, prev_ts = 0, wall0 = 0, seq = 0;
+    const void *data;
+    uint64_t ts_ms;
+
+    while (!stop) {
+        ssize_t len = archive_next(cursor, &data, &ts_ms);
+        if (len <= 0)
+            break;
+
+        // 按录像时间轴排期：第 n 帧在 wall0 + (ts - first_ts) / speed 发出。
+        // 时间戳是墙上时间，NTP 校时会让它倒退或前跳；录像中断也会留下空档。
+        // 遇到这些情况从当前帧重新排期，立即发出，而不是按差值睡很久
+        uint64_t now = trace_now_ns() / 1000;
+        if (seq == 0 || ts_ms < prev_ts || ts_ms - prev_ts > PLAYBACK_GAP_MAX_MS) {
+            first_ts = ts_ms;
+            wall0 = now;
+        }
+        prev_ts = ts_ms;
+        uint64_t due = wall0 + (uint64_t)((ts_ms - first_ts) * 1000 / speed);
+        while (!stop && now < due) {
+            uint64_t wait_us = due - now;
+            if (wait_us > PLAYBACK_SLEEP_MAX_MS * 1000)
+                wait_us = PLAYBACK_SLEEP_MAX_MS * 1000;
+            struct timespec ts = { 0, (long)wait_us * 1000 };
+            nanosleep(&ts, nullptr);
+            now = trace_now_ns() / 1000;
+        }
+        if (stop)
+            break;
+
+        uint64_t t0 = trace_now_ns();
+        std::shared_ptr<Frame> frame = pool.get((size_t)len);
+        memcpy(frame->data.data(), data, (size_t)len);
+        frame->ts_us = now;
+        frame->seq = seq++;
+        box.post(frame);
+        trace_complete("playback", t0, (int32_t)len);
+    }
+}
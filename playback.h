@@ -0,0 +1,46 @@
+// playback.h
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include <memory>
+
+extern "C" {
+#include "archive.h"
+}
+#include "frame.h"
+#include "thread.h"
+
+/*
+ * 一个客户端的录像回放：独立线程在归档中定位，按原始帧间隔（可加速）读取，
+ * 最新帧投递到自己的信箱，由网络线程像直播帧一样发给该客户端。
+ * 读到归档末尾时投递 "playback end"，时间点之后没有录像时投递
+ * "no recording after <ms>"，然后结束。
+ *
+ * 析构时不等待回放线程（它可能正阻塞在读盘上）：线程带着共享的会话状态脱离，
+ * 在下一次检查停止标志时自行退出。关闭归档前用 drain() 等它们全部结束。
+ */
+class Playback {
+public:
+    Playback(struct archive *a, uint64_t from_ms, double speed, FramePool &pool);
+    ~Playback();
+
+    // 线程创建失败返回 -1
+    int start();
+
+    int fd() const;
+    FramePtr take();
+
+    // 等待所有回放线程结束
+    static void drain();
+
+private:
+    Playback(const Playback &) = delete;
+    Playback &operator=(const Playback &) = delete;
+
+    struct Session;
+
+    std::shared_ptr<Session> s_;
+    Thread thread_;
+};
+
+#endif // PLAYBACK_H
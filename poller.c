@@ -0,0 +1,444 @@
+// poller.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "serial.h"
+#include "poller.h"
+#include "trace.h"
+#include "topology.h"
+
+#define POLL_RXBUF_SIZE      256
+#define POLL_BACKOFF_MAX_MS  30000
+#define POLL_OFFLINE_FAILS   3
+#define POLL_IDLE_WAIT_MS    100
+
+struct poll_sensor {
+    unsigned short addr;
+    unsigned int interval_ms;       // 0：只被动接收
+    uint64_t next_due;              // 下次发请求的时间
+    uint64_t sent_at;               // 在途请求的发出时间，0 表示不在途
+    unsigned int fails;             // 连续超时次数
+    unsigned char frame[POLL_FRAME_MAX];
+    size_t len;
+    uint64_t rx_at;
+};
+
+struct poller {
+    int fd;
+    int window;
+    unsigned int timeout_ms;
+    int inflight;
+
+    pthread_mutex_t lock;
+    pthread_t tid;
+    volatile int stop;
+    int running;
+
+    struct poll_sensor sensors[POLL_MAX_SENSORS];
+    int nsensors;
+
+    unsigned char rxbuf[POLL_RXBUF_SIZE];
+    size_t rxlen;
+
+    poller_frame_cb cb;
+    void *cb_arg;
+};
+
+uint64_t poller_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+unsigned char poller_crc8(const unsigned char *buf, size_t len)
+{
+    unsigned char crc = 0;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; ++b)
+            crc = (crc & 0x80) ? (unsigned char)((crc << 1) ^ 0x07) : (unsigned char)(crc << 1);
+    }
+    return crc;
+}
+
+size_t poller_build_query(unsigned short addr, unsigned char *out, size_t outlen)
+{
+    // 与控制帧同构，数据字节 0x3f（'?'）表示查询
+    const unsigned char tmpl[11] = {0x21, 0x01, 0x09, 0x01, 0x57, 0x40, 0x00, 0x00, 0x00, 0x3f, 0x00};
+    if (outlen < sizeof(tmpl))
+        return 0;
+
+    memcpy(out, tmpl, sizeof(tmpl));
+    out[6] = (unsigned char)(addr >> 8);
+    out[7] = (unsigned char)(addr & 0xff);
+    out[10] = poller_crc8(out, 10);
+    return sizeof(tmpl);
+}
+
+struct poller *poller_create(int fd, int window, unsigned int timeout_ms)
+{
+    if (window < 1 || window > POLL_MAX_WINDOW || timeout_ms == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct poller *p = calloc(1, sizeof(*p));
+    if (!p)
+        return NULL;
+
+    p->fd = fd;
+    p->window = window;
+    p->timeout_ms = timeout_ms;
+    pthread_mutex_init(&p->lock, NULL);
+    return p;
+}
+
+static struct poll_sensor *find_sensor(struct poller *p, unsigned short addr)
+{
+    for (int i = 0; i < p->nsensors; ++i) {
+        if (p->sensors[i].addr == addr)
+            return &p->sensors[i];
+    }
+    return NULL;
+}
+
+static struct poll_sensor *add_sensor_locked(struct poller *p, unsigned short addr,
+                                             unsigned int interval_ms)
+{
+    struct poll_sensor *s = find_sensor(p, addr);
+    if (!s) {
+        if (p->nsensors >= POLL_MAX_SENSORS)
+            return NULL;
+        s = &p->sensors[p->nsensors++];
+        memset(s, 0, sizeof(*s));
+        s->addr = addr;
+    }
+    s->interval_ms = interval_ms;
+    return s;
+}
+
+int poller_add_sensor(struct poller *p, unsigned short addr, unsigned int interval_ms)
+{
+    pthread_mutex_lock(&p->lock);
+    struct poll_sensor *s = add_sensor_locked(p, addr, interval_ms);
+    pthread_mutex_unlock(&p->lock);
+    return s ? 0 : -1;
+}
+
+int poller_load_config(struct poller *p, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    char line[128];
+    int count = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+
+        char *end;
+        unsigned long addr = strtoul(line, &end, 0);
+        if (end == line)
+            continue;   // 空行
+        unsigned long interval = strtoul(end, NULL, 0);
+        if (addr > 0xffff) {
+            fprintf(stderr, "poller: bad address in %s: %s", path, line);
+            continue;
+        }
+        if (poller_add_sensor(p, (unsigned short)addr, (unsigned int)interval) == 0)
+            count++;
+    }
+
+    fclose(fp);
+    return count;
+}
+
+void poller_set_callback(struct poller *p, poller_frame_cb cb, void *arg)
+{
+    pthread_mutex_lock(&p->lock);
+    p->cb = cb;
+    p->cb_arg = arg;
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void deliver_frame(struct poller *p, const unsigned char *f, size_t len, uint64_t now)
+{
+    unsigned short addr = POLL_FRAME_ADDR(f);
+    struct poll_sensor *s = find_sensor(p, addr);
+    if (!s)
+        s = add_sensor_locked(p, addr, 0);   // 主动上报的新节点：登记为被动节点
+    if (!s)
+        return;
+
+    int matched = 0;
+    if (s->sent_at) {
+        // 按节点地址匹配在途请求；下一次按发出时间对齐周期，避免漂移
+        matched = 1;
+        p->inflight--;
+        s->next_due = s->sent_at + s->interval_ms;
+        if (s->next_due < now)
+            s->next_due = now;
+        s->sent_at = 0;
+    }
+    s->fails = 0;
+
+    memcpy(s->frame, f, len);
+    s->len = len;
+    s->rx_at = now;
+
+    trace_instant(matched ? "serial_rx" : "serial_rx_report", addr);
+    if (p->cb)
+        p->cb(p->cb_arg, addr, f, len, matched);
+}
+
+int poller_feed(struct poller *p, const unsigned char *data, size_t n, uint64_t now_ms)
+{
+    int frames = 0;
+
+    pthread_mutex_lock(&p->lock);
+    while (n > 0) {
+        size_t chunk = POLL_RXBUF_SIZE - p->rxlen;
+        if (chunk > n)
+            chunk = n;
+        memcpy(p->rxbuf + p->rxlen, data, chunk);
+        p->rxlen += chunk;
+        data += chunk;
+        n -= chunk;
+
+        size_t pos = 0;
+        while (pos < p->rxlen) {
+            unsigned char *f = p->rxbuf + pos;
+            size_t avail = p->rxlen - pos;
+
+            if (f[0] != POLL_SOF) {
+                // 重同步：跳到下一个帧头
+                unsigned char *sof = memchr(f, POLL_SOF, avail);
+                pos = sof ? (size_t)(sof - p->rxbuf) : p->rxlen;
+                continue;
+            }
+            if (avail < 3)
+                break;
+
+            size_t total = (size_t)f[2] + 2;
+            if (total < POLL_FRAME_MIN || total > POLL_FRAME_MAX) {
+                pos++;
+                continue;
+            }
+            if (avail < total)
+                break;
+            if (poller_crc8(f, total - 1) != f[total - 1]) {
+                pos++;
+                continue;
+            }
+
+            deliver_frame(p, f, total, now_ms);
+            frames++;
+            pos += total;
+        }
+
+        p->rxlen -= pos;
+        memmove(p->rxbuf, p->rxbuf + pos, p->rxlen);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return frames;
+}
+
+static int send_query_locked(struct poller *p, struct poll_sensor *s, uint64_t now)
+{
+    unsigned char req[16];
+    size_t len = poller_build_query(s->addr, req, sizeof(req));
+    uint64_t t0 = trace_now_ns();
+    if (serial_send_exact_nbytes(p->fd, req, len) != (ssize_t)len)
+        return -1;
+    trace_complete("serial_tx", t0, s->addr);
+
+    s->sent_at = now;
+    p->inflight++;
+    return 0;
+}
+
+int poller_tick(struct poller *p, uint64_t now_ms)
+{
+    uint64_t next = now_ms + POLL_IDLE_WAIT_MS;
+
+    pthread_mutex_lock(&p->lock);
+
+    // 1. 超时处理：指数退避，无应答节点不会长期占用窗口
+    for (int i = 0; i < p->nsensors; ++i) {
+        struct poll_sensor *s = &p->sensors[i];
+        if (!s->sent_at)
+            continue;
+
+        uint64_t deadline = s->sent_at + p->timeout_ms;
+        if (deadline <= now_ms) {
+            unsigned int shift = s->fails < 16 ? s->fails : 16;
+            uint64_t backoff = (uint64_t)p->timeout_ms << shift;
+            if (backoff > POLL_BACKOFF_MAX_MS)
+                backoff = POLL_BACKOFF_MAX_MS;
+
+            s->fails++;
+            s->sent_at = 0;
+            s->next_due = now_ms + s->interval_ms + backoff;
+            p->inflight--;
+            if (s->fails == POLL_OFFLINE_FAILS)
+                fprintf(stderr, "poller: node 0x%04x not responding\n", s->addr);
+        } else if (deadline < next) {
+            next = deadline;
+        }
+    }
+
+    // 2. 在窗口内按到期先后发出请求
+    while (p->inflight < p->window) {
+        struct poll_sensor *due = NULL;
+        for (int i = 0; i < p->nsensors; ++i) {
+            struct poll_sensor *s = &p->sensors[i];
+            if (!s->interval_ms || s->sent_at || s->next_due > now_ms)
+                continue;
+            if (!due || s->next_due < due->next_due)
+                due = s;
+        }
+        if (!due)
+            break;
+        if (send_query_locked(p, due, now_ms) == -1) {
+            due->next_due = now_ms + p->timeout_ms;
+            break;
+        }
+        if (due->sent_at + p->timeout_ms < next)
+            next = due->sent_at + p->timeout_ms;
+    }
+
+    // 3. 窗口有空位时，下一个到期时间也是唤醒点
+    if (p->inflight < p->window) {
+        for (int i = 0; i < p->nsensors; ++i) {
+            struct poll_sensor *s = &p->sensors[i];
+            if (s->interval_ms && !s->sent_at && s->next_due < next)
+                next = s->next_due;
+        }
+    }
+
+    pthread_mutex_unlock(&p->lock);
+
+    return next > now_ms ? (int)(next - now_ms) : 0;
+}
+
+static void *poller_thread(void *arg)
+{
+    struct poller *p = arg;
+    unsigned char buf[POLL_RXBUF_SIZE];
+
+    trace_thread_name("serial");
+    while (!p->stop) {
+        int wait_ms = poller_tick(p, poller_now_ms());
+        if (wait_ms > POLL_IDLE_WAIT_MS)
+            wait_ms = POLL_IDLE_WAIT_MS;    // 保证 poller_stop 能及时生效
+
+        struct pollfd pfd = { .fd = p->fd, .events = POLLIN };
+        int ret = poll(&pfd, 1, wait_ms);
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            perror("poller: poll");
+            break;
+        }
+        if (ret == 0)
+            continue;
+
+        ssize_t n = read(p->fd, buf, sizeof(buf));
+        if (n == -1) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("poller: read");
+            break;
+        }
+        if (n > 0)
+            poller_feed(p, buf, (size_t)n, poller_now_ms());
+    }
+
+    return NULL;
+}
+
+int poller_start(struct poller *p)
+{
+    p->stop = 0;
+    if (topo_thread_create(&p->tid, poller_thread, p) != 0)
+        return -1;
+    p->running = 1;
+    return 0;
+}
+
+void poller_stop(struct poller *p)
+{
+    if (!p->running)
+        return;
+    p->stop = 1;
+    pthread_join(p->tid, NULL);
+    p->running = 0;
+}
+
+void poller_destroy(struct poller *p)
+{
+    if (!p)
+        return;
+    poller_stop(p);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+}
+
+pthread_t poller_thread_id(const struct poller *p)
+{
+    return p->tid;
+}
+
+ssize_t poller_send(struct poller *p, unsigned char *buf, size_t len)
+{
+    pthread_mutex_lock(&p->lock);
+    uint64_t t0 = trace_now_ns();
+    ssize_t ret = serial_send_exact_nbytes(p->fd, buf, len);
+    trace_complete("serial_tx", t0, len >= 8 ? POLL_FRAME_ADDR(buf) : 0);
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+
+int poller_get_frame(struct poller *p, unsigned short addr,
+                     unsigned char *frame, size_t framelen, uint64_t *age_ms)
+{
+    int ret = -1;
+
+    pthread_mutex_lock(&p->lock);
+    struct poll_sensor *s = find_sensor(p, addr);
+    if (s) {
+        ret = 0;
+        if (s->len && s->len <= framelen) {
+            memcpy(frame, s->frame, s->len);
+            ret = (int)s->len;
+            if (age_ms)
+                *age_ms = poller_now_ms() - s->rx_at;
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return ret;
+}
+
+void poller_foreach(struct poller *p, poller_visit_cb cb, void *arg)
+{
+    uint64_t now = poller_now_ms();
+
+    pthread_mutex_lock(&p->lock);
+    for (int i = 0; i < p->nsensors; ++i) {
+        struct poll_sensor *s = &p->sensors[i];
+        cb(arg, s->addr, s->frame, s->len, s->len ? now - s->rx_at : 0,
+           s->fails >= POLL_OFFLINE_FAILS);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
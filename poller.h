@@ -0,0 +1,132 @@
+// poller.h
+#ifndef POLLER_H
+#define POLLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+/*
+ * ZigBee 串口帧格式（与 server.cpp 中的控制帧一致）：
+ *   [0]    0x21 帧头
+ *   [1]    0x01
+ *   [2]    len，帧总长 = len + 2
+ *   [3..5] 网络/协调器字段（0x01 0x57 0x40）
+ *   [6]    节点类型（0x2a 光照, 0x2b 温湿度, 0x2c 风扇, 0x2e 门锁）
+ *   [7]    节点编号
+ *   [8..]  数据
+ *   [末尾] CRC-8（多项式 0x07，初值 0，覆盖除自身外的全部字节）
+ * 节点地址 = ([6] << 8) | [7]
+ */
+#define POLL_SOF          0x21
+#define POLL_FRAME_MIN    10
+#define POLL_FRAME_MAX    64
+#define POLL_MAX_SENSORS  64
+#define POLL_MAX_WINDOW   16
+
+#define POLL_FRAME_ADDR(f) ((unsigned short)(((f)[6] << 8) | (f)[7]))
+
+struct poller;
+
+/**
+ * @brief 收到一帧有效数据时的回调（在轮询线程中调用，持有内部锁，勿回调 poller_*）
+ * @param addr 节点地址
+ * @param frame 完整帧（含帧头与 CRC）
+ * @param len 帧长度
+ * @param matched 1 表示匹配到一个在途请求，0 表示设备主动上报
+ */
+typedef void (*poller_frame_cb)(void *arg, unsigned short addr,
+                                const unsigned char *frame, size_t len, int matched);
+
+/**
+ * @brief 计算 CRC-8（poly 0x07, init 0）
+ */
+unsigned char poller_crc8(const unsigned char *buf, size_t len);
+
+/**
+ * @brief 构造一帧查询请求（数据字节为 '?'）
+ * @return 帧长度
+ */
+size_t poller_build_query(unsigned short addr, unsigned char *out, size_t outlen);
+
+/**
+ * @brief 创建轮询调度器
+ * @param fd 已初始化的串口 fd（不接管其生命周期）
+ * @param window 同时在途的最大请求数（1..POLL_MAX_WINDOW）
+ * @param timeout_ms 单个请求的应答超时
+ */
+struct poller *poller_create(int fd, int window, unsigned int timeout_ms);
+
+/**
+ * @brief 注册一个需要主动轮询的节点
+ * @param interval_ms 轮询周期；0 表示只被动接收上报
+ * @return 0 成功，-1 失败（表满或参数错误）
+ */
+int poller_add_sensor(struct poller *p, unsigned short addr, unsigned int interval_ms);
+
+/**
+ * @brief 从配置文件加载节点，每行 "<addr> <interval_ms>"，支持 0x 前缀和 # 注释
+ * @return 加载的节点数，文件不存在返回 -1
+ */
+int poller_load_config(struct poller *p, const char *path);
+
+void poller_set_callback(struct poller *p, poller_frame_cb cb, void *arg);
+
+/**
+ * @brief 向串口输入原始字节流（解析、重同步并匹配在途请求）
+ * @return 解析出的有效帧数
+ */
+int poller_feed(struct poller *p, const unsigned char *data, size_t n, uint64_t now_ms);
+
+/**
+ * @brief 处理超时并在窗口允许时发出到期的请求
+ * @return 距下一个截止时间的毫秒数（用于 poll 超时）
+ */
+int poller_tick(struct poller *p, uint64_t now_ms);
+
+/**
+ * @brief 启动/停止后台轮询线程
+ */
+int poller_start(struct poller *p);
+void poller_stop(struct poller *p);
+void poller_destroy(struct poller *p);
+
+/**
+ * @brief 轮询线程句柄（用于设置 CPU 绑定和调度策略），须在 poller_start 之后调用
+ */
+pthread_t poller_thread_id(const struct poller *p);
+
+/**
+ * @brief 线程安全地向串口发送一帧（与轮询请求互斥）
+ */
+ssize_t poller_send(struct poller *p, unsigned char *buf, size_t len);
+
+/**
+ * @brief 读取节点最近一次的有效帧
+ * @param age_ms 输出：距今毫秒数
+ * @return 帧长度，从未收到返回 0，节点不存在返回 -1
+ */
+int poller_get_frame(struct poller *p, unsigned short addr,
+                     unsigned char *frame, size_t framelen, uint64_t *age_ms);
+
+/**
+ * @brief 遍历所有节点（包括被动上报自动登记的节点）
+ * @param cb 每个节点回调一次；offline 表示连续超时已进入退避
+ */
+typedef void (*poller_visit_cb)(void *arg, unsigned short addr,
+                                const unsigned char *frame, size_t len,
+                                uint64_t age_ms, int offline);
+void poller_foreach(struct poller *p, poller_visit_cb cb, void *arg);
+
+uint64_t poller_now_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POLLER_H
@@ -0,0 +1,45 @@
+// proto.c
+#include <stdio.h>
+#include <string.h>
+
+#include "proto.h"
+
+int proto_encode_header(char hdr[PROTO_HDR_LEN], int type, uint32_t len)
+{
+    if (type == PROTO_IMAGE) {
+        if (len > 999999999u)
+            return -1;
+        snprintf(hdr, PROTO_HDR_LEN, "%09u", len);
+    } else {
+        if (len > PROTO_MAX_LEN)
+            return -1;
+        snprintf(hdr, PROTO_HDR_LEN, "%c%08u", type, len);
+    }
+    return 0;
+}
+
+int proto_decode_header(const char hdr[PROTO_HDR_LEN], int *type, uint32_t *len)
+{
+    int first = 0;
+    if (hdr[0] < '0' || hdr[0] > '9') {
+        if (hdr[0] < 'A' || hdr[0] > 'Z')
+            return -1;
+        *type = hdr[0];
+        first = 1;
+    } else {
+        *type = PROTO_IMAGE;
+    }
+
+    // 手工解析，避免 strtoul 在缺少结尾 '\0' 时越界
+    uint32_t val = 0;
+    for (int i = first; i < PROTO_HDR_LEN - 1; ++i) {
+        if (hdr[i] < '0' || hdr[i] > '9')
+            return -1;
+        val = val * 10 + (uint32_t)(hdr[i] - '0');
+    }
+    if (hdr[PROTO_HDR_LEN - 1] != '\0')
+        return -1;
+
+    *len = val;
+    return 0;
+}
@@ -0,0 +1,52 @@
+// proto.h
+#ifndef PROTO_H
+#define PROTO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 服务端 -> 客户端消息格式：10 字节头 + 负载
+ *
+ *   图像：   "%09u\0"        —— 与现有客户端兼容，首字节为数字
+ *   其他：   "%c%08u\0"      —— 首字节为类型字母
+ *
+ * 只有发送过 subscribe_sensors 的客户端才会收到传感器消息；
+ * 文本消息（T）是命令应答和状态通知。状态通知（上游连接/断开等）
+ * 只发给用过 subscribe_status、subscribe_sensors、sites/site 或回放命令
+ * 的客户端，只认图像头的旧客户端不会收到。
+ *
+ * 客户端 -> 服务端：命令字符串，可用 '\n' 分隔多条。
+ */
+
+#define PROTO_HDR_LEN   10
+#define PROTO_MAX_LEN   99999999u   // 8 位十进制长度上限
+
+#define PROTO_IMAGE     0           // 图像帧（旧格式头）
+#define PROTO_SENSOR    'S'         // 负载为原始 ZigBee 串口帧
+#define PROTO_TEXT      'T'         // 负载为文本
+
+/**
+ * @brief 编码消息头
+ * @param type PROTO_IMAGE / PROTO_SENSOR / PROTO_TEXT
+ * @return 0 成功，-1 长度超出范围
+ */
+int proto_encode_header(char hdr[PROTO_HDR_LEN], int type, uint32_t len);
+
+/**
+ * @brief 解码消息头
+ * @param type 输出消息类型
+ * @param len 输出负载长度
+ * @return 0 成功，-1 格式错误
+ */
+int proto_decode_header(const char hdr[PROTO_HDR_LEN], int *type, uint32_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROTO_H
@@ -0,0 +1,306 @@
+// relay.cpp
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+extern "C" {
+#include "proto.h"
+#include "trace.h"
+#include "topology.h"
+}
+#include "relay.h"
+
+#define RELAY_BACKOFF_MIN_MS 500
+#define RELAY_BACKOFF_MAX_MS 8000
+#define RELAY_CONNECT_TIMEOUT_MS 5000
+#define RELAY_POLL_MS        100            // 解析/连接时检查停止标志的间隔
+#define RELAY_KEEPIDLE_S     5              // 空闲多久开始探测
+#define RELAY_KEEPINTVL_S    2
+#define RELAY_KEEPCNT        3              // 半开连接约 11s 后判定断开
+#define RELAY_USER_TIMEOUT_MS 10000         // 已发数据多久未确认即断开
+#define RELAY_MSG_MAX        (16u << 20)    // 单条消息上限，够放 1080p YUYV；更大视为流已错位
+
+// 阻塞读满 n 字节；返回 0 成功，-1 连接关闭或出错
+static int recv_exact(int fd, void *buf, size_t n)
+{
+    size_t got = 0;
+    while (got < n) {
+        ssize_t ret = recv(fd, (char *)buf + got, n - got, 0);
+        if (ret == 0)
+            return -1;
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        got += ret;
+    }
+    return 0;
+}
+
+Upstream::Upstream(int index, const std::string &host, int port, FramePool &pool,
+                   FrameMailbox &frames, MessageQueue &msgs)
+    : index_(index), host_(host), port_(port), name_(host + ":" + std::to_string(port)),
+      pool_(pool), frames_(frames), msgs_(msgs), fd_(-1), stop_(false), connected_(false)
+{
+}
+
+Upstream::~Upstream()
+{
+    stop();
+}
+
+int Upstream::start()
+{
+    return thread_.start([this] { run(); });
+}
+
+void Upstream::stop()
+{
+    stop_ = true;
+    {
+        std::lock_guard<std::mutex> guard(fd_lock_);
+        if (fd_ != -1)
+            shutdown(fd_, SHUT_RDWR);   // 唤醒阻塞在 recv 上的线程
+    }
+    if (thread_.joinable())
+        thread_.join();
+}
+
+int Upstream::send_command(const std::string &cmd)
+{
+    std::string line = cmd + "\n";
+
+    // 在网络线程上调用，不能阻塞：上游不读时发送缓冲区满，直接丢弃这条命令
+    std::lock_guard<std::mutex> guard(fd_lock_);
+    if (fd_ == -1 || !connected_)
+        return -1;
+    ssize_t ret = send(fd_, line.data(), line.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (ret == (ssize_t)line.size())
+        return 0;
+    if (ret < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            perror("relay: forward command");
+        return -1;
+    }
+    // 只发出半行，上游的命令流已错位，断开让接收线程重连
+    std::fprintf(stderr, "relay: %s: command truncated, resetting\n", name_.c_str());
+    shutdown(fd_, SHUT_RDWR);
+    return -1;
+}
+
+int Upstream::parse_list(const char *spec, std::vector<std::pair<std::string, int> > &out)
+{
+    std::string s(spec);
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t comma = s.find(',', pos);
+        std::string item = s.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        size_t colon = item.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 >= item.size()) {
+            std::fprintf(stderr, "relay: expected host:port, got '%s'\n", item.c_str());
+            return -1;
+        }
+        int port = std::atoi(item.c_str() + colon + 1);
+        if (port <= 0 || port > 65535) {
+            std::fprintf(stderr, "relay: bad port in '%s'\n", item.c_str());
+            return -1;
+        }
+        out.push_back(std::make_pair(item.substr(0, colon), port));
+        if (comma == std::string::npos)
+            break;
+        pos = comma + 1;
+    }
+    return 0;
+}
+
+void Upstream::post_text(const std::string &text)
+{
+    std::printf("%s\n", text.c_str());
+    msgs_.post(index_, make_message(PROTO_TEXT, text.data(), text.size()));
+}
+
+// 异步解析主机名，期间可被 stop() 打断；返回 0 成功
+int Upstream::resolve(struct addrinfo **res)
+{
+    // 解析被打断而无法取消时 glibc 仍会写这些内存，所以放在堆上
+    struct request {
+        struct gaicb cb;
+        struct addrinfo hints;
+        std::string port;
+    };
+    request *req = new request();
+    req->hints.ai_family = AF_UNSPEC;
+    req->hints.ai_socktype = SOCK_STREAM;
+    req->port = std::to_string(port_);
+    req->cb.ar_name = host_.c_str();
+    req->cb.ar_service = req->port.c_str();
+    req->cb.ar_request = &req->hints;
+
+    struct gaicb *list[1] = { &req->cb };
+    int err = getaddrinfo_a(GAI_NOWAIT, list, 1, nullptr);
+    if (err) {
+        std::fprintf(stderr, "relay: %s: %s\n", name_.c_str(), gai_strerror(err));
+        delete req;
+        return -1;
+    }
+
+    struct timespec slice = { 0, RELAY_POLL_MS * 1000000L };
+    while ((err = gai_error(&req->cb)) == EAI_INPROGRESS) {
+        if (stop_) {
+            if (gai_cancel(&req->cb) == EAI_NOTCANCELED)
+                return -1;  // 只发生在退出路径上，放弃这块内存
+            break;
+        }
+        gai_suspend(list, 1, &slice);
+    }
+    if (err == EAI_INPROGRESS)
+        err = gai_error(&req->cb);
+    if (err == 0) {
+        *res = req->cb.ar_result;
+    } else {
+        if (err != EAI_CANCELED)
+            std::fprintf(stderr, "relay: %s: %s\n", name_.c_str(), gai_strerror(err));
+        freeaddrinfo(req->cb.ar_result);
+    }
+    delete req;
+    return err == 0 ? 0 : -1;
+}
+
+// 非阻塞连接一个地址，最多等待 RELAY_CONNECT_TIMEOUT_MS；成功返回阻塞模式的套接字
+int Upstream::connect_addr(const struct addrinfo *ai)
+{
+    int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, ai->ai_protocol);
+    if (fd == -1)
+        return -1;
+
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+        if (errno != EINPROGRESS) {
+            close(fd);
+            return -1;
+        }
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        int waited = 0, ret = 0;
+        while (!stop_ && waited < RELAY_CONNECT_TIMEOUT_MS &&
+               (ret = poll(&pfd, 1, RELAY_POLL_MS)) == 0)
+            waited += RELAY_POLL_MS;
+        int err = 0;
+        socklen_t errlen = sizeof(err);
+        if (ret <= 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen) == -1 || err) {
+            if (!stop_)
+                std::fprintf(stderr, "relay: %s: connect: %s\n", name_.c_str(),
+                             ret == 0 ? "timed out" : strerror(ret < 0 ? errno : err));
+            close(fd);
+            return -1;
+        }
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    return fd;
+}
+
+int Upstream::open_connection()
+{
+    struct addrinfo *res = nullptr;
+    if (resolve(&res) == -1)
+        return -1;
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd == -1 && !stop_; ai = ai->ai_next)
+        fd = connect_addr(ai);
+    freeaddrinfo(res);
+    if (fd == -1)
+        return -1;
+
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    // 广域网上对端掉电或路由中断时没有 FIN，靠保活探测和未确认超时发现半开连接，
+    // 之后 recv 以 ETIMEDOUT 返回，进入重连
+    int idle = RELAY_KEEPIDLE_S, intvl = RELAY_KEEPINTVL_S, cnt = RELAY_KEEPCNT;
+    unsigned int user_timeout = RELAY_USER_TIMEOUT_MS;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+    setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &user_timeout, sizeof(user_timeout));
+    return fd;
+}
+
+void Upstream::run()
+{
+    topo_apply(pthread_self(), TOPO_NETWORK);
+    trace_thread_name("upstream");
+
+    int backoff_ms = RELAY_BACKOFF_MIN_MS;
+    uint64_t seq = 0;
+
+    while (!stop_) {
+        int fd = open_connection();
+        if (fd == -1) {
+            // 可中断的退避等待
+            for (int waited = 0; waited < backoff_ms && !stop_; waited += RELAY_POLL_MS)
+                usleep(RELAY_POLL_MS * 1000);
+            backoff_ms = backoff_ms * 2 > RELAY_BACKOFF_MAX_MS ? RELAY_BACKOFF_MAX_MS : backoff_ms * 2;
+            continue;
+        }
+        backoff_ms = RELAY_BACKOFF_MIN_MS;
+
+        {
+            std::lock_guard<std::mutex> guard(fd_lock_);
+            fd_ = fd;
+        }
+        connected_ = true;
+        post_text("upstream " + name_ + " connected");
+        send_command("subscribe_sensors");
+
+        while (!stop_) {
+            char hdr[PROTO_HDR_LEN];
+            int type;
+            uint32_t len;
+            if (recv_exact(fd, hdr, sizeof(hdr)) == -1)
+                break;
+            if (proto_decode_header(hdr, &type, &len) == -1) {
+                std::fprintf(stderr, "relay: %s: bad header, resetting\n", name_.c_str());
+                break;
+            }
+            if (len > RELAY_MSG_MAX) {
+                std::fprintf(stderr, "relay: %s: message of %u bytes exceeds %u, resetting\n",
+                             name_.c_str(), len, RELAY_MSG_MAX);
+                break;
+            }
+
+            uint64_t t0 = trace_now_ns();
+            std::shared_ptr<Frame> msg = pool_.get(len);
+            if (len && recv_exact(fd, msg->data.data(), len) == -1)
+                break;
+            msg->type = type;
+            msg->ts_us = trace_now_ns() / 1000;
+            msg->seq = seq++;
+
+            if (type == PROTO_IMAGE) {
+                trace_complete("upstream_rx", t0, index_);
+                frames_.post(msg);
+            } else {
+                msgs_.post(index_, msg);
+            }
+        }
+
+        connected_ = false;
+        {
+            std::lock_guard<std::mutex> guard(fd_lock_);
+            close(fd_);
+            fd_ = -1;
+        }
+        if (!stop_)
+            post_text("upstream " + name_ + " disconnected");
+    }
+}
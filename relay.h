@@ -0,0 +1,71 @@
+// relay.h
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "frame.h"
+#include "thread.h"
+
+struct addrinfo;
+
+/*
+ * 中继模式的上游连接：每个远端站点只保持一条 TCP 连接，
+ * 订阅其视频和传感器流，最新帧投递到本站点的信箱，
+ * 传感器/文本消息投递到网络线程的消息队列；下游命令经此转发回上游。
+ * 断线后按指数退避自动重连；解析和连接都可被 stop() 打断，
+ * TCP 保活探测发现广域网上的半开连接。
+ */
+class Upstream {
+public:
+    Upstream(int index, const std::string &host, int port, FramePool &pool,
+             FrameMailbox &frames, MessageQueue &msgs);
+    ~Upstream();
+
+    // 0 成功，-1 线程创建失败
+    int start();
+    void stop();
+
+    // 转发一条命令到上游（网络线程调用，不阻塞）；未连接或发送缓冲区满返回 -1
+    int send_command(const std::string &cmd);
+
+    const std::string &name() const { return name_; }
+    bool connected() const { return connected_; }
+
+    /**
+     * @brief 解析 "host:port[,host:port...]"
+     * @return 0 成功，-1 格式错误
+     */
+    static int parse_list(const char *spec, std::vector<std::pair<std::string, int> > &out);
+
+private:
+    Upstream(const Upstream &) = delete;
+    Upstream &operator=(const Upstream &) = delete;
+
+    void run();
+    int resolve(struct addrinfo **res);
+    int connect_addr(const struct addrinfo *ai);
+    int open_connection();
+    void post_text(const std::string &text);
+
+    int index_;
+    std::string host_;
+    int port_;
+    std::string name_;
+
+    FramePool &pool_;
+    FrameMailbox &frames_;
+    MessageQueue &msgs_;
+
+    std::mutex fd_lock_;        // 保护 fd_ 的替换与发送
+    int fd_;
+    std::atomic<bool> stop_;
+    std::atomic<bool> connected_;
+    Thread thread_;
+};
+
+#endif // RELAY_H
@@ -3,259 +3,755 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
-#include <sys/wait.h>
+#include <poll.h>
+#include <sys/inotify.h>
 #include <csignal>
 #include <fcntl.h>
 #include <string>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 extern "C" {
 #include "serial.h"   // serial_init, serial_send_exact_nbytes, serial_recv_exact_nbytes
 #include "cam.h"      // camera_init, camera_start, camera_dqbuf, etc.
+#include "poller.h"   // poller_create, poller_send, poller_foreach
+#include "framebus.h" // fbus_create, fbus_publish
+#include "trace.h"    // trace_complete, trace_dump_async
+#include "topology.h" // topo_apply, topo_lock_memory, jitter_*
+#include "proto.h"    // proto_encode_header
+#include "archive.h"  // archive_open, archive_append
+#include "command.h"  // command_find
 }
+#include "frame.h"    // FramePool, FrameMailbox, MessageQueue
+#include "relay.h"    // Upstream
+#include "playback.h" // Playback
+#include "dispatch.h" // client_command, NetState
+#include "thread.h"   // Thread
+#include "client.h"   // Client, client_flush, client_recv
+
+#define SENSORS_CONF    "sensors.conf"
+#define POLL_WINDOW     8
+#define POLL_TIMEOUT_MS 200
+#define FBUS_SLOTS      8
+#define MAX_CLIENTS     32
+#define REC_QUEUE       64      // 记录线程积压帧上限，磁盘跟不上时丢弃最旧的帧
+#define ARCHIVE_FLUSH_MS 500    // 归档批量缓冲区最长滞留时间
+#define CAPTURE_RETRY_MIN_MS 50 // 摄像头重开失败后的重试间隔
+#define CAPTURE_RETRY_MAX_MS 1000
+
+// 全局传感器值：串口线程写、网络线程读
+std::atomic<int> temp_val(0);
+std::atomic<int> wet_val(0);
+std::atomic<int> light_val(0);
+
+// 全局串口 fd
+int g_serial_fd = -1;
 
-#define BUFFER_SIZE 1024
+// 传感器轮询调度器（串口线程），串口关闭时为空
+struct poller *g_poller = nullptr;
 
-// 全局传感器值（可选，当前未用于发送）
-int temp_val = 0;
-int wet_val = 0;
-int light_val = 0;
+static std::atomic<bool> g_stop(false);
 
-// 全局串口 fd（由主进程初始化，子进程继承）
-int g_serial_fd = -1;
+// 帧总线共享内存名，"none" 表示关闭（同机多实例时需各自指定）
+static const char *g_fbus_name = FBUS_NAME_DEFAULT;
+static unsigned int g_fbus_mode = FBUS_MODE_DEFAULT;   // -M，允许哪些用户的读者进程
 
-void handle_received_string(int clientfd)
-{
-    char recv_buffer[BUFFER_SIZE];
-    unsigned char wind_on_buf[11]  = {0x21, 0x01, 0x09, 0x01, 0x57, 0x40, 0x2c, 0x66, 0x00, 0x31, 0x90};
-    unsigned char wind_off_buf[11] = {0x21, 0x01, 0x09, 0x01, 0x57, 0x40, 0x2c, 0x66, 0x00, 0x30, 0x97};
-    unsigned char lock_on_buf[11]  = {0x21, 0x01, 0x09, 0x01, 0x57, 0x40, 0x2e, 0x72, 0x00, 0x31, 0xb5};
-    unsigned char lock_off_buf[11] = {0x21, 0x01, 0x09, 0x01, 0x57, 0x40, 0x2e, 0x72, 0x00, 0x30, 0xb2};
-    unsigned char temp_val_buf[12] = {0};
-
-    while (true) {
-        int ret = recv(clientfd, recv_buffer, BUFFER_SIZE - 1, 0);
-        if (ret <= 0) {
-            break;
-        }
-        recv_buffer[ret] = '\0'; // ✅ 确保字符串结尾
+// 出队等待超时（-W），超过即认为设备卡住并重开
+static int g_stall_ms = 2000;
 
-        if (strcmp(recv_buffer, "wind_on") == 0) {
-            serial_send_exact_nbytes(g_serial_fd, wind_on_buf, sizeof(wind_on_buf));
-            printf("Received: %s\n", recv_buffer);
-        }
-        else if (strcmp(recv_buffer, "wind_off") == 0) {
-            serial_send_exact_nbytes(g_serial_fd, wind_off_buf, sizeof(wind_off_buf));
-            printf("Received: %s\n", recv_buffer);
-        }
-        else if (strcmp(recv_buffer, "lock_on") == 0) {
-            serial_send_exact_nbytes(g_serial_fd, lock_on_buf, sizeof(lock_on_buf));
-            printf("Received: %s\n", recv_buffer);
-        }
-        else if (strcmp(recv_buffer, "lock_off") == 0) {
-            serial_send_exact_nbytes(g_serial_fd, lock_off_buf, sizeof(lock_off_buf));
-            printf("Received: %s\n", recv_buffer);
-        }
-        else if (strcmp(recv_buffer, "get_temp_val") == 0) {
-            // 发送查询指令（根据你的设备协议，可能需要先发请求）
-            // 假设设备会主动上报，或已处于上报模式
+// 线程间传递帧：采集线程（或中继上游线程）生产，网络线程和记录线程各取最新帧。
+// 本地模式只有一个视频源；中继模式每个上游站点一个视频源。
+static FramePool g_pool;
+static std::vector<std::unique_ptr<FrameMailbox> > g_sources;
+static MessageQueue g_rec_q(REC_QUEUE);  // 记录线程按顺序消费，不只取最新帧
+static MessageQueue g_msgs;     // 传感器读数和状态文本，带视频源编号
 
-            while (true) {
-                if (serial_recv_exact_nbytes(g_serial_fd, temp_val_buf, sizeof(temp_val_buf)) != 0) {
-                    break; // 超时或错误
-                }
+// 连续录像归档（-R），为空时记录线程只覆盖 1.jpg
+static struct archive *g_archive = nullptr;
 
-                // ✅ 修复：使用 == 而不是 =
-                if (temp_val_buf[6] == 0x2a || temp_val_buf[6] == 0x2e) {
-                    // 跳过无关帧
-                    char buf_device[10] = {0};
-                    serial_recv_exact_nbytes(g_serial_fd, buf_device, 10);
-                    continue;
-                }
-                else if (temp_val_buf[6] == 0x2b) {
-                    // 温湿度帧：通常两个字节组合为 16 位值
-                    // 假设大端：[9]=高8位, [10]=低8位
-                    temp_val = (temp_val_buf[9] << 8) | temp_val_buf[10];
-                    wet_val  = (temp_val_buf[11] << 8) | temp_val_buf[12]; // 注意：原缓冲区只有12字节？需确认
-                    // ⚠️ 你的 temp_val_buf 是 12 字节，索引最大为 11
-                    // 所以湿度假设在 [10][11]
-                    wet_val = (temp_val_buf[10] << 8) | temp_val_buf[11];
-                    printf("temp_val:%d, wet_val:%d\n", temp_val, wet_val);
-                    break;
-                }
-                else if (temp_val_buf[6] == 0x2a) {
-                    // 光照强度
-                    light_val = (temp_val_buf[9] << 8) | temp_val_buf[10];
-                    printf("light_val:%d\n", light_val);
-                    break;
-                }
-            }
+// 中继模式的上游连接，与 g_sources 一一对应；本地模式为空
+static std::vector<std::unique_ptr<Upstream> > g_upstreams;
+
+// 轮询线程回调：解析温湿度/光照帧，更新全局值
+static void on_sensor_frame(void *, unsigned short addr,
+                            const unsigned char *frame, size_t len, int)
+{
+    // 数据从 [9] 开始，最后一个字节是 CRC；按各类型需要的数据字节数检查帧长
+    switch (addr >> 8) {
+    case 0x2b:
+        // 温湿度帧：大端 16 位。4 字节数据时 [9][10]=温度，[11][12]=湿度；
+        // 12 字节的短帧只有 2 字节数据，沿用原实现的取法：湿度取 [10][11]（[11] 为 CRC）
+        if (len >= 14) {
+            temp_val = (frame[9] << 8) | frame[10];
+            wet_val = (frame[11] << 8) | frame[12];
+        } else if (len >= 12) {
+            temp_val = (frame[9] << 8) | frame[10];
+            wet_val = (frame[10] << 8) | frame[11];
         }
+        break;
+    case 0x2a:
+        // 光照强度：2 字节数据，帧长 >= 12
+        if (len >= 12)
+            light_val = (frame[9] << 8) | frame[10];
+        break;
+    default:
+        break;
     }
 
-    close(clientfd);
-    _exit(0); // 子进程直接退出，不调用全局析构
+    // 原始帧转发给订阅了传感器流的客户端（包括下游中继）
+    g_msgs.post(0, make_message(PROTO_SENSOR, frame, len));
 }
 
-int main(int argc, char **argv)
+static void print_sensor(void *, unsigned short addr, const unsigned char *frame,
+                         size_t len, uint64_t age_ms, int offline)
 {
-    if (argc != 3) {
-        std::fprintf(stderr, "Usage: %s <video_device> <port>\n", argv[0]);
-        return -1;
+    printf("node 0x%04x: %s", addr, offline ? "offline" : "online");
+    if (len) {
+        printf(", age %llums, data", (unsigned long long)age_ms);
+        for (size_t i = 8; i + 1 < len; ++i)
+            printf(" %02x", frame[i]);
     }
+    printf("\n");
+}
 
-    // 初始化串口（只做一次！）
-    g_serial_fd = serial_init("/dev/ttyS4", 115200);
-    if (g_serial_fd < 0) {
-        perror("serial_init");
-        return -1;
+static void on_stop_signal(int)
+{
+    g_stop = true;
+}
+
+void handle_command(const char *cmd)
+{
+    const struct command *c = command_find(cmd);
+    if (!c)
+        return;
+
+    if (c->frame_len) {
+        if (!g_poller) {
+            printf("Serial disabled, ignored: %s\n", cmd);
+            return;
+        }
+        unsigned char buf[COMMAND_FRAME_MAX];
+        memcpy(buf, c->frame, c->frame_len);
+        poller_send(g_poller, buf, c->frame_len);
+        printf("Received: %s\n", cmd);
     }
+    else {
+        // get_temp_val：读数由轮询线程持续刷新，这里直接输出缓存值，不再阻塞等待设备上报
+        if (g_poller)
+            poller_foreach(g_poller, print_sensor, nullptr);
+        printf("temp_val:%d, wet_val:%d, light_val:%d\n",
+               temp_val.load(), wet_val.load(), light_val.load());
+    }
+}
 
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd == -1) {
-        perror("socket");
-        serial_exit(g_serial_fd);
+// 采集状态通知：打印并发给本地视频源中订阅了状态的客户端（旧客户端只会看到画面暂停）
+static void capture_status(const std::string &text)
+{
+    std::printf("%s\n", text.c_str());
+    g_msgs.post(0, make_message(PROTO_TEXT, text.data(), text.size()));
+}
+
+// 监视设备节点所在目录，udev 创建节点或修改权限时唤醒；不可用时返回 -1
+static int watch_device(const char *devpath)
+{
+    const char *node = camera_node_path(devpath);
+    if (!node)
         return -1;
-    }
 
-    struct sockaddr_in serveraddr{};
-    serveraddr.sin_family = AF_INET;
-    serveraddr.sin_addr.s_addr = htonl(INADDR_ANY);
-    serveraddr.sin_port = htons(std::atoi(argv[2]));
+    std::string dir(node);
+    size_t slash = dir.rfind('/');
+    dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : dir.substr(0, slash));
 
-    if (bind(sockfd, (struct sockaddr *)&serveraddr, sizeof(serveraddr)) == -1) {
-        perror("bind");
-        close(sockfd);
-        serial_exit(g_serial_fd);
+    int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ifd == -1) {
+        perror("inotify_init1");
         return -1;
     }
-
-    if (listen(sockfd, 10) == -1) {
-        perror("listen");
-        close(sockfd);
-        serial_exit(g_serial_fd);
+    if (inotify_add_watch(ifd, dir.c_str(), IN_CREATE | IN_ATTRIB) == -1) {
+        perror("inotify_add_watch");
+        close(ifd);
         return -1;
     }
+    return ifd;
+}
 
-    std::printf("Waiting for connection on port %s...\n", argv[2]);
-    int clientfd = accept(sockfd, nullptr, nullptr);
-    if (clientfd == -1) {
-        perror("accept");
-        close(sockfd);
-        serial_exit(g_serial_fd);
-        return -1;
+/*
+ * 设备丢失后在采集线程中重新打开：节点出现（inotify 唤醒）即按上次的格式重开
+ * （*ismjpeg 同时返回实际协商到的格式），
+ * 失败时按 CAPTURE_RETRY_MIN_MS..CAPTURE_RETRY_MAX_MS 退避重试，
+ * 兼顾节点已存在但驱动尚未就绪、以及没有 inotify 的情况。
+ */
+static int capture_reopen(char *devpath, int ifd, unsigned int *width, unsigned int *height,
+                          unsigned int *size, unsigned int *ismjpeg)
+{
+    const char *node = camera_node_path(devpath);
+    int backoff_ms = CAPTURE_RETRY_MIN_MS;
+
+    while (!g_stop) {
+        if (!node || access(node, F_OK) == 0) {
+            int fd = camera_reopen(devpath, width, height, size, ismjpeg);
+            if (fd != -1) {
+                if (camera_start(fd) == 0)
+                    return fd;
+                camera_exit(fd);
+            }
+        }
+
+        struct pollfd pfd = {ifd, POLLIN, 0};
+        int wait_ms = node && access(node, F_OK) == -1 && ifd != -1 ? CAPTURE_RETRY_MAX_MS : backoff_ms;
+        if (poll(&pfd, ifd != -1 ? 1 : 0, wait_ms) > 0) {
+            char events[4096];
+            while (read(ifd, events, sizeof(events)) > 0)
+                ;
+            backoff_ms = CAPTURE_RETRY_MIN_MS;
+        } else {
+            backoff_ms = backoff_ms * 2 > CAPTURE_RETRY_MAX_MS ? CAPTURE_RETRY_MAX_MS : backoff_ms * 2;
+        }
     }
+    return -1;
+}
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("fork");
-        close(clientfd);
-        close(sockfd);
-        serial_exit(g_serial_fd);
-        return -1;
+/*
+ * 采集线程：设备初始化后持续出流；每帧复制一次后立即归还驱动缓冲区，
+ * 再分发给帧总线、网络线程和记录线程，任何消费者都不会阻塞采集。
+ * 出队超时或设备丢失（ENODEV 等）时通知客户端 "stream stalled"，
+ * 客户端连接保持不变，后台按上次的格式重开设备后继续出流。
+ */
+static void capture_thread(char *devpath, size_t jitter_frames)
+{
+    topo_apply(pthread_self(), TOPO_CAPTURE);
+    trace_thread_name("capture");
+
+    camera_set_timeout(g_stall_ms);
+
+    unsigned int width = 640, height = 480;
+    unsigned int size = 0, index = 0, ismjpeg = 0;
+    int fd = camera_init(devpath, &width, &height, &size, &ismjpeg);
+    if (fd == -1) {
+        std::fprintf(stderr, "Camera init failed\n");
+        g_stop = true;
+        return;
     }
-    else if (pid == 0) {
-        // 子进程：处理命令（继承 g_serial_fd 和 clientfd）
-        close(sockfd); // 子进程不需要监听 socket
-        handle_received_string(clientfd);
-        // 不会返回
+    std::printf("Camera %ux%u %s\n", width, height, ismjpeg ? "MJPEG" : "YUYV");
+
+    // 槽位大小取驱动缓冲区长度，足以容纳任意一帧
+    struct fbus *bus = nullptr;
+    unsigned int bus_size = size;
+    if (strcmp(g_fbus_name, "none") != 0) {
+        bus = fbus_create(g_fbus_name, FBUS_SLOTS, bus_size, g_fbus_mode);
+        if (!bus && errno == EBUSY) {
+            // 另一个实例正在发布同名总线，不能抢走它的读者
+            std::fprintf(stderr, "Use -B to pick another frame bus name, or -B none\n");
+            camera_exit(fd);
+            g_stop = true;
+            return;
+        }
+    }
+    if (bus)
+        fbus_set_format(bus, width, height, ismjpeg);
+    else
+        std::fprintf(stderr, "Frame bus disabled\n");
+
+    struct jitter jit;
+    bool bench = jitter_frames > 0 && jitter_init(&jit, jitter_frames) == 0;
+
+    if (camera_start(fd) == -1) {
+        camera_exit(fd);
+        fbus_destroy(bus);
+        g_stop = true;
+        return;
     }
-    else {
-        // 父进程：持续拍照并发送
-        close(clientfd); // 父进程不处理命令，但注意：子进程已持有 clientfd 副本
-        // ⚠️ 问题：父进程无法向子进程的 clientfd 发送数据！
-
-        // ❗ 重大架构问题：父子进程各自持有 clientfd 副本，
-        // 但父进程关闭了它的副本，无法发送图像！
 
-        // ✅ 临时解决方案：不在父进程发图，而是在子进程中同时处理命令和发图
-        // 但你要求分离，所以必须重构！
+    // Drain initial frames
+    void *jpeg_ptr = nullptr;
+    for (int i = 0; i < 5 && !g_stop; i++) {
+        if (camera_dqbuf(fd, &jpeg_ptr, &size, &index) == -1 ||
+            camera_eqbuf(fd, index) == -1) {
+            g_stop = true;
+        }
+    }
 
-        // 由于时间关系，我们采用折中：**放弃 fork，改用单进程轮询**
-        // 但你坚持 fork，那么只能让父进程也持有 clientfd（不 close）
+    int ifd = watch_device(devpath);
+    uint64_t seq = 0;
+    uint64_t stalled_ns = 0;    // 非零：设备丢失的时刻，首帧到达时报告恢复
+    bool done = false;
 
-        // 修正：父进程不要 close(clientfd)
-        // 已在上面注释掉 close(clientfd)
+    while (!g_stop && !done) {
+        if (fd == -1) {
+            unsigned int was_mjpeg = ismjpeg;
+            fd = capture_reopen(devpath, ifd, &width, &height, &size, &ismjpeg);
+            if (fd == -1)
+                break;
+            if (ismjpeg != was_mjpeg)
+                std::printf("Camera %ux%u %s\n", width, height, ismjpeg ? "MJPEG" : "YUYV");
+            // 格式尽量沿用上次，缓冲区大小通常不变；万一变大则重建帧总线（已有读者需重新打开）
+            if (bus && size > bus_size) {
+                fbus_destroy(bus);
+                bus_size = size;
+                bus = fbus_create(g_fbus_name, FBUS_SLOTS, bus_size, g_fbus_mode);
+            }
+            if (bus)
+                fbus_set_format(bus, width, height, ismjpeg);
+        }
 
-        // 重新打开 clientfd 供父进程使用（实际是同一个连接）
-        // 不需要，因为 fork 后父子共享文件描述符表，clientfd 仍然有效
+        while (!g_stop) {
+            uint64_t t0 = trace_now_ns();
+            if (camera_dqbuf(fd, &jpeg_ptr, &size, &index) == -1)
+                break;
+            uint64_t t_frame = trace_now_ns();
+            trace_complete("dqbuf", t0, index);
 
-        // 所以：删除上面的 close(clientfd)，让父进程保留 clientfd
+            if (stalled_ns) {
+                capture_status("stream resumed after " +
+                               std::to_string((t_frame - stalled_ns) / 1000000) + " ms");
+                stalled_ns = 0;
+            }
 
-        // 但为了清晰，我们重新设计：父进程保留 clientfd 用于发图
-        // 子进程也保留用于收命令 —— 这在 TCP 上是允许的（全双工）
+            if (bench && jitter_add(&jit, t_frame)) {
+                jitter_report(&jit, stdout);
+                done = true;
+                break;
+            }
 
-        // 因此，注释掉父进程中的 close(clientfd)
+            uint64_t ts_us = fbus_now_us();
+            if (bus) {
+                t0 = trace_now_ns();
+                fbus_publish(bus, jpeg_ptr, size, ts_us);
+                trace_complete("publish", t0, size);
+            }
 
-        // 继续父进程逻辑：
-        unsigned int width = 640, height = 480;
-        while (true) {
-            usleep(50000); // 20 FPS
+            t0 = trace_now_ns();
+            FramePtr frame = g_pool.make(jpeg_ptr, size, ts_us, seq++);
+            trace_complete("copy", t0, size);
 
-            unsigned int size = 0, index = 0, ismjpeg = 0;
-            int fd = camera_init(argv[1], &width, &height, &size, &ismjpeg);
-            if (fd == -1) {
-                std::fprintf(stderr, "Camera init failed\n");
+            t0 = trace_now_ns();
+            if (camera_eqbuf(fd, index) == -1)
                 break;
+            trace_complete("eqbuf", t0, index);
+
+            g_sources[0]->post(frame);
+            g_rec_q.post(0, frame);
+            trace_complete("frame", t_frame, size);
+        }
+        if (g_stop || done)
+            break;
+
+        // 设备丢失或卡住：释放后重开，客户端保持连接
+        int err = errno;
+        stalled_ns = trace_now_ns();
+        trace_instant("stall", err);
+        capture_status(std::string("stream stalled: ") + strerror(err));
+        camera_stop(fd);
+        camera_exit(fd);
+        fd = -1;
+    }
+
+    if (fd != -1) {
+        camera_stop(fd);
+        camera_exit(fd);
+    }
+    if (ifd != -1)
+        close(ifd);
+    g_stop = true;
+    fbus_destroy(bus);
+    if (bench)
+        jitter_free(&jit);
+}
+
+/*
+ * 记录线程：有归档时把每一帧追加到段文件，否则保存最新一帧到 1.jpg。
+ * 采集线程只向有界队列投递，磁盘慢时丢弃积压的旧帧，不影响采集。
+ */
+static void recorder_thread()
+{
+    topo_apply(pthread_self(), TOPO_RECORDER);
+    trace_thread_name("recorder");
+
+    uint64_t last_flush = fbus_now_us();
+    struct pollfd pfd = {g_rec_q.fd(), POLLIN, 0};
+
+    while (!g_stop) {
+        int ret = poll(&pfd, 1, 100);
+
+        if (g_archive && fbus_now_us() - last_flush >= ARCHIVE_FLUSH_MS * 1000) {
+            uint64_t t0 = trace_now_ns();
+            archive_flush(g_archive);
+            trace_complete("archive_flush", t0, 0);
+            last_flush = fbus_now_us();
+        }
+        if (ret <= 0)
+            continue;
+
+        std::deque<std::pair<int, FramePtr> > frames = g_rec_q.take_all();
+        if (frames.empty())
+            continue;
+
+        if (!g_archive) {
+            const FramePtr &frame = frames.back().second;
+            uint64_t t0 = trace_now_ns();
+            int pixfd = open("1.jpg", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if (pixfd != -1) {
+                if (write(pixfd, frame->data.data(), frame->data.size()) == -1)
+                    perror("write 1.jpg");
+                close(pixfd);
             }
+            trace_complete("save", t0, (int32_t)frame->data.size());
+            continue;
+        }
 
-            if (camera_start(fd) == -1) {
-                camera_exit(fd);
-                break;
+        // 帧时间戳是单调时钟，换算成采集时刻的 Unix 毫秒
+        uint64_t now_real = archive_now_ms();
+        uint64_t now_mono = fbus_now_us();
+        for (auto &f : frames) {
+            const FramePtr &frame = f.second;
+            uint64_t age_ms = now_mono > frame->ts_us ? (now_mono - frame->ts_us) / 1000 : 0;
+            uint64_t t0 = trace_now_ns();
+            if (archive_append(g_archive, frame->data.data(), frame->data.size(),
+                               now_real - age_ms) == -1)
+                std::fprintf(stderr, "archive: append failed\n");
+            trace_complete("archive", t0, (int32_t)frame->data.size());
+        }
+    }
+}
+
+/*
+ * 网络线程：一个 poll 循环处理监听、所有客户端的命令和消息发送。
+ * 每个客户端最多持有一帧在发送、一帧待发送，慢客户端只会丢帧。
+ */
+static void network_thread(int listenfd)
+{
+    topo_apply(pthread_self(), TOPO_NETWORK);
+    trace_thread_name("network");
+
+    std::vector<std::unique_ptr<Client> > clients;
+    std::vector<struct pollfd> pfds;
+    const size_t nsrc = g_sources.size();
+    const size_t first_client = 2 + nsrc;
+
+    NetState st;
+    st.latest.resize(nsrc);
+    st.sensors.resize(nsrc);
+    const DispatchEnv env = { nsrc, &g_upstreams, g_archive, &g_pool, handle_command };
+
+    while (!g_stop) {
+        pfds.clear();
+        pfds.push_back({listenfd, POLLIN, 0});
+        pfds.push_back({g_msgs.fd(), POLLIN, 0});
+        for (auto &src : g_sources)
+            pfds.push_back({src->fd(), POLLIN, 0});
+        for (auto &c : clients)
+            pfds.push_back({c->fd, (short)(POLLIN | (c->cur ? POLLOUT : 0)), 0});
+        for (auto &c : clients)
+            pfds.push_back({c->play ? c->play->fd() : -1, POLLIN, 0});
+
+        int ret = poll(pfds.data(), pfds.size(), 100);
+        trace_poll();
+        if (ret <= 0)
+            continue;
+
+        for (size_t s = 0; s < nsrc; ++s) {
+            if (!(pfds[2 + s].revents & POLLIN))
+                continue;
+            FramePtr frame = g_sources[s]->take();
+            if (!frame)
+                continue;
+            st.latest[s] = frame;
+            for (auto &c : clients) {
+                if (c->source == (int)s && !c->play)
+                    client_post_frame(*c, frame);
             }
+        }
 
-            // Drain initial frames
-            void *jpeg_ptr = nullptr;
-            for (int i = 0; i < 5; i++) {
-                if (camera_dqbuf(fd, &jpeg_ptr, &size, &index) == -1 ||
-                    camera_eqbuf(fd, index) == -1) {
-                    camera_stop(fd);
-                    camera_exit(fd);
-                    goto parent_exit;
+        if (pfds[1].revents & POLLIN) {
+            for (auto &m : g_msgs.take_all()) {
+                int s = m.first;
+                const FramePtr &msg = m.second;
+                if (s < 0 || s >= (int)nsrc)
+                    continue;
+                if (msg->type == PROTO_SENSOR && msg->data.size() >= 8)
+                    st.sensors[s][POLL_FRAME_ADDR(msg->data.data())] = msg;
+                for (auto &c : clients) {
+                    bool want = msg->type == PROTO_SENSOR ? c->sensors :
+                                msg->type == PROTO_TEXT ? c->status : true;
+                    if (c->source == s && want)
+                        client_post_ctrl(*c, msg);
                 }
             }
+        }
 
-            // Capture one frame
-            if (camera_dqbuf(fd, &jpeg_ptr, &size, &index) == -1) {
-                camera_stop(fd);
-                camera_exit(fd);
-                break;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client &c = *clients[i];
+            if (!c.play || !(pfds[first_client + clients.size() + i].revents & POLLIN))
+                continue;
+            FramePtr frame = c.play->take();
+            if (!frame)
+                continue;
+            if (frame->type == PROTO_IMAGE) {
+                client_post_frame(c, frame);
+                continue;
             }
+            // 回放结束或定位失败，回到直播
+            c.play.reset();
+            client_post_ctrl(c, frame);
+            if (st.latest[c.source])
+                client_post_frame(c, st.latest[c.source]);
+        }
 
-            // Save to file
-            int pixfd = open("1.jpg", O_WRONLY | O_CREAT | O_TRUNC, 0666);
-            if (pixfd != -1) {
-                write(pixfd, jpeg_ptr, size);
-                close(pixfd);
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client &c = *clients[i];
+            short rev = pfds[first_client + i].revents;
+            bool dead = (rev & (POLLERR | POLLNVAL)) != 0;
+            if (!dead && (rev & (POLLIN | POLLHUP)))
+                dead = client_recv(c, [&](const char *line) { client_command(c, st, env, line); }) == -1;
+            if (!dead && c.cur)
+                dead = client_flush(c) == -1;
+            if (dead) {
+                std::printf("Client %d disconnected\n", c.fd);
+                close(c.fd);
+                c.fd = -1;
+                c.play.reset();
             }
+        }
+        for (size_t i = 0; i < clients.size();) {
+            if (clients[i]->fd == -1)
+                clients.erase(clients.begin() + i);
+            else
+                ++i;
+        }
 
-            // Send size as 10-byte zero-padded string (compatible with your client)
-            char size_buf[10] = {0};
-            std::snprintf(size_buf, sizeof(size_buf), "%09u", size);
-            if (write(clientfd, size_buf, 10) != 10) {
-                perror("send size");
-                break;
+        if (pfds[0].revents & POLLIN) {
+            int clientfd = accept4(listenfd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (clientfd == -1) {
+                perror("accept");
+            } else if (clients.size() >= MAX_CLIENTS) {
+                std::fprintf(stderr, "Too many clients, rejecting %d\n", clientfd);
+                close(clientfd);
+            } else {
+                std::printf("Client %d connected\n", clientfd);
+                std::unique_ptr<Client> c(new Client);
+                c->fd = clientfd;
+                clients.push_back(std::move(c));
             }
+        }
+    }
+
+    for (auto &c : clients)
+        close(c->fd);
+}
+
+static void usage(const char *prog)
+{
+    std::fprintf(stderr,
+        "Usage: %s [options] <video_device> <port>\n"
+        "       %s [options] -u <host:port,...> <port>   (relay mode)\n"
+        "  -u <list>   relay: subscribe to upstream servers and re-serve their streams\n"
+        "  -S <dev>    serial device (default /dev/ttyS4, or none in relay mode;\n"
+        "              \"none\" to disable)\n"
+        "  -B <name>   frame bus shared memory name (default " FBUS_NAME_DEFAULT ", \"none\" to disable)\n"
+        "  -M <mode>   frame bus access mode in octal (default 0660: owner and group)\n"
+        "  -a <spec>   CPU pinning, e.g. capture=3,serial=2,net=1,rec=0\n"
+        "  -p <spec>   SCHED_FIFO priority, e.g. capture=80,serial=70\n"
+        "  -m          mlockall() to keep the hot path free of page faults\n"
+        "  -j <n>      jitter benchmark: report inter-frame intervals of n frames and exit\n"
+        "  -R <dir>    continuous recording into segment files under dir\n"
+        "  -Z <MB>     recording segment size (default 64)\n"
+        "  -A <sec>    delete recordings older than sec (default: keep)\n"
+        "  -C <MB>     cap total recording size (default: unlimited)\n"
+        "  -D          write recordings with O_DIRECT\n"
+        "  -W <ms>     reopen the camera when no frame arrives for ms (default 2000)\n",
+        prog, prog);
+}
 
-            // Send image data
-            if (write(clientfd, jpeg_ptr, size) != (ssize_t)size) {
-                perror("send image");
+int main(int argc, char **argv)
+{
+    char default_serial[] = "/dev/ttyS4";
+    char no_serial[] = "none";
+    char *serial_dev = nullptr;
+    bool lock_memory = false;
+    size_t jitter_frames = 0;
+    std::vector<std::pair<std::string, int> > upstreams;
+    const char *archive_dir = nullptr;
+    struct archive_conf aconf{};
+    aconf.segment_bytes = 64ULL << 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "u:S:B:M:a:p:mj:R:Z:A:C:DW:")) != -1) {
+        switch (opt) {
+        case 'u':
+            if (Upstream::parse_list(optarg, upstreams) == -1)
+                return -1;
+            break;
+        case 'S': serial_dev = optarg; break;
+        case 'B': g_fbus_name = optarg; break;
+        case 'M': g_fbus_mode = (unsigned int)std::strtoul(optarg, nullptr, 8); break;
+        case 'a':
+            if (topo_parse_affinity(optarg) == -1)
+                return -1;
+            break;
+        case 'p':
+            if (topo_parse_priority(optarg) == -1)
+                return -1;
+            break;
+        case 'm': lock_memory = true; break;
+        case 'j': jitter_frames = std::strtoul(optarg, nullptr, 10); break;
+        case 'R': archive_dir = optarg; break;
+        case 'Z': aconf.segment_bytes = std::strtoull(optarg, nullptr, 10) << 20; break;
+        case 'A': aconf.max_age_ms = std::strtoull(optarg, nullptr, 10) * 1000; break;
+        case 'C': aconf.max_bytes = std::strtoull(optarg, nullptr, 10) << 20; break;
+        case 'D': aconf.direct_io = 1; break;
+        case 'W': g_stall_ms = std::atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    bool relay = !upstreams.empty();
+    if (argc - optind != (relay ? 1 : 2)) {
+        usage(argv[0]);
+        return -1;
+    }
+    char *video_dev = relay ? nullptr : argv[optind];
+    const char *port = argv[argc - 1];
+    if (!serial_dev)
+        serial_dev = relay ? no_serial : default_serial;
+    if (archive_dir && (relay || aconf.segment_bytes == 0)) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // kill -USR1 <pid> 导出时间线（trace-<pid>.json）
+    trace_install_signal(SIGUSR1);
+
+    // 在创建线程之前锁定，MCL_FUTURE 覆盖之后的线程栈和帧缓冲
+    if (lock_memory)
+        topo_lock_memory();
+
+    // 初始化串口（只做一次！）
+    if (strcmp(serial_dev, "none") != 0) {
+        g_serial_fd = serial_init(serial_dev, 115200);
+        if (g_serial_fd < 0) {
+            perror("serial_init");
+            return -1;
+        }
+
+        // 轮询调度器：在途窗口内并发查询所有节点，按节点地址匹配应答
+        g_poller = poller_create(g_serial_fd, POLL_WINDOW, POLL_TIMEOUT_MS);
+        if (!g_poller) {
+            perror("poller_create");
+            serial_exit(g_serial_fd);
+            return -1;
+        }
+        int nsensors = poller_load_config(g_poller, SENSORS_CONF);
+        if (nsensors < 0)
+            printf("%s not found, only passive sensor reports are used\n", SENSORS_CONF);
+        else
+            printf("Polling %d sensor nodes\n", nsensors);
+        poller_set_callback(g_poller, on_sensor_frame, nullptr);
+        if (poller_start(g_poller) == -1) {
+            poller_destroy(g_poller);
+            serial_exit(g_serial_fd);
+            return -1;
+        }
+        topo_apply(poller_thread_id(g_poller), TOPO_SERIAL);
+    }
+
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd == -1) {
+        perror("socket");
+        poller_destroy(g_poller);
+        if (g_serial_fd >= 0)
+            serial_exit(g_serial_fd);
+        return -1;
+    }
+
+    int on = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in serveraddr{};
+    serveraddr.sin_family = AF_INET;
+    serveraddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    serveraddr.sin_port = htons(std::atoi(port));
+
+    if (bind(sockfd, (struct sockaddr *)&serveraddr, sizeof(serveraddr)) == -1 ||
+        listen(sockfd, 10) == -1) {
+        perror("bind/listen");
+        close(sockfd);
+        poller_destroy(g_poller);
+        if (g_serial_fd >= 0)
+            serial_exit(g_serial_fd);
+        return -1;
+    }
+
+    if (archive_dir) {
+        g_archive = archive_open(archive_dir, &aconf);
+        if (!g_archive) {
+            std::fprintf(stderr, "Cannot open archive %s\n", archive_dir);
+            close(sockfd);
+            poller_destroy(g_poller);
+            if (g_serial_fd >= 0)
+                serial_exit(g_serial_fd);
+            return -1;
+        }
+        std::printf("Recording to %s\n", archive_dir);
+    }
+
+    std::printf("Waiting for connection on port %s...\n", port);
+
+    // 视频源：本地模式为摄像头，中继模式为每个上游站点
+    size_t nsrc = relay ? upstreams.size() : 1;
+    for (size_t i = 0; i < nsrc; ++i)
+        g_sources.push_back(std::unique_ptr<FrameMailbox>(new FrameMailbox));
+    for (size_t i = 0; i < upstreams.size(); ++i) {
+        g_upstreams.push_back(std::unique_ptr<Upstream>(
+            new Upstream((int)i, upstreams[i].first, upstreams[i].second,
+                         g_pool, *g_sources[i], g_msgs)));
+        std::printf("Relay site %zu: %s\n", i, g_upstreams[i]->name().c_str());
+    }
+
+    // 任一线程创建失败（如 -m 时超出 RLIMIT_MEMLOCK）都整体退出
+    int status = 0;
+    Thread net, rec, cap;
+    if (net.start([sockfd] { network_thread(sockfd); }) == -1 ||
+        rec.start(recorder_thread) == -1) {
+        status = -1;
+    } else if (relay) {
+        for (auto &up : g_upstreams) {
+            if (up->start() == -1) {
+                status = -1;
                 break;
             }
-
-            camera_eqbuf(fd, index);
-            camera_stop(fd);
-            camera_exit(fd);
         }
-parent_exit:
-        kill(pid, SIGTERM);
-        wait(nullptr);
+        while (!g_stop && status == 0)
+            usleep(100000);
+        for (auto &up : g_upstreams)
+            up->stop();
+    } else {
+        if (cap.start([=] { capture_thread(video_dev, jitter_frames); }) == -1)
+            status = -1;
+        cap.join();     // 采集结束（初始化失败、基准完成或收到信号）即整体退出
     }
+    g_stop = true;
+    net.join();
+    rec.join();
+    Playback::drain();
+    archive_close(g_archive);
 
     close(sockfd);
-    serial_exit(g_serial_fd);
-    return 0;
+    poller_destroy(g_poller);
+    if (g_serial_fd >= 0)
+        serial_exit(g_serial_fd);
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+// thread.cpp
+extern "C" {
+#include "topology.h"
+}
+#include "thread.h"
+
+void *Thread::trampoline(void *arg)
+{
+    std::function<void()> *fn = static_cast<std::function<void()> *>(arg);
+    (*fn)();
+    delete fn;
+    return nullptr;
+}
+
+int Thread::start(std::function<void()> fn)
+{
+    std::function<void()> *arg = new std::function<void()>(std::move(fn));
+    if (topo_thread_create(&tid_, trampoline, arg) != 0) {
+        delete arg;
+        return -1;
+    }
+    running_ = true;
+    return 0;
+}
+
+void Thread::join()
+{
+    if (running_) {
+        pthread_join(tid_, nullptr);
+        running_ = false;
+    }
+}
+
+void Thread::detach()
+{
+    if (running_) {
+        pthread_detach(tid_);
+        running_ = false;
+    }
+}
@@ -0,0 +1,36 @@
+// thread.h
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <functional>
+#include <pthread.h>
+
+/*
+ * 工作线程：经 topo_thread_create 以小栈创建。与 std::thread 不同，
+ * 创建失败（如 mlockall 下超出 RLIMIT_MEMLOCK）时返回 -1 而不是抛异常。
+ */
+class Thread {
+public:
+    Thread() : running_(false) {}
+    ~Thread() { join(); }
+
+    // 0 成功，-1 创建失败（已打印原因）
+    int start(std::function<void()> fn);
+    void join();
+    // 不再等待线程结束，线程自己负责它用到的资源
+    void detach();
+
+    bool joinable() const { return running_; }
+    pthread_t id() const { return tid_; }
+
+private:
+    Thread(const Thread &) = delete;
+    Thread &operator=(const Thread &) = delete;
+
+    static void *trampoline(void *arg);
+
+    pthread_t tid_;
+    bool running_;
+};
+
+#endif // THREAD_H
@@ -0,0 +1,239 @@
+// topology.c
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "topology.h"
+
+struct topo_conf {
+    int cpu;        // -1：不绑定
+    int rt_prio;    // 0：SCHED_OTHER
+};
+
+static const char *g_role_names[TOPO_ROLES] = { "capture", "net", "serial", "rec" };
+
+static struct topo_conf g_conf[TOPO_ROLES] = {
+    { -1, 0 }, { -1, 0 }, { -1, 0 }, { -1, 0 },
+};
+
+const char *topo_role_name(enum topo_role role)
+{
+    return role < TOPO_ROLES ? g_role_names[role] : "?";
+}
+
+// 解析 "role=value,..."，对每一项调用 set
+static int parse_spec(const char *spec, int is_prio)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", spec);
+
+    char *save = NULL;
+    for (char *item = strtok_r(buf, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char *eq = strchr(item, '=');
+        if (!eq) {
+            fprintf(stderr, "topology: expected role=value, got '%s'\n", item);
+            return -1;
+        }
+        *eq = '\0';
+
+        int role = -1;
+        for (int r = 0; r < TOPO_ROLES; ++r) {
+            if (strcmp(item, g_role_names[r]) == 0)
+                role = r;
+        }
+        if (role < 0) {
+            fprintf(stderr, "topology: unknown role '%s'\n", item);
+            return -1;
+        }
+
+        char *end;
+        long val = strtol(eq + 1, &end, 10);
+        if (*end != '\0' || val < 0 || (is_prio && val > 99) || (!is_prio && val >= CPU_SETSIZE)) {
+            fprintf(stderr, "topology: bad value for %s: '%s'\n", item, eq + 1);
+            return -1;
+        }
+
+        if (is_prio)
+            g_conf[role].rt_prio = (int)val;
+        else
+            g_conf[role].cpu = (int)val;
+    }
+    return 0;
+}
+
+int topo_parse_affinity(const char *spec)
+{
+    return parse_spec(spec, 0);
+}
+
+int topo_parse_priority(const char *spec)
+{
+    return parse_spec(spec, 1);
+}
+
+int topo_apply(pthread_t tid, enum topo_role role)
+{
+    const struct topo_conf *c = &g_conf[role];
+    int ret = 0;
+
+    char name[16];
+    snprintf(name, sizeof(name), "ps-%s", g_role_names[role]);
+    pthread_setname_np(tid, name);
+
+    if (c->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(c->cpu, &set);
+        int err = pthread_setaffinity_np(tid, sizeof(set), &set);
+        if (err) {
+            fprintf(stderr, "topology: pin %s to cpu %d: %s\n", name, c->cpu, strerror(err));
+            ret = -1;
+        }
+    }
+
+    if (c->rt_prio > 0) {
+        struct sched_param sp;
+        memset(&sp, 0, sizeof(sp));
+        sp.sched_priority = c->rt_prio;
+        int err = pthread_setschedparam(tid, SCHED_FIFO, &sp);
+        if (err) {
+            fprintf(stderr, "topology: SCHED_FIFO %d for %s: %s\n", c->rt_prio, name, strerror(err));
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int topo_apply_default(pthread_t tid, const char *name)
+{
+    int ret = 0;
+    pthread_setname_np(tid, name);
+
+    // 全集与进程的 cpuset 取交集，即恢复为可在所有允许的 CPU 上运行
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(tid, sizeof(set), &set);
+    if (err) {
+        fprintf(stderr, "topology: unpin %s: %s\n", name, strerror(err));
+        ret = -1;
+    }
+
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    err = pthread_setschedparam(tid, SCHED_OTHER, &sp);
+    if (err) {
+        fprintf(stderr, "topology: SCHED_OTHER for %s: %s\n", name, strerror(err));
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int topo_lock_memory(void)
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        perror("mlockall");
+        return -1;
+    }
+    return 0;
+}
+
+int topo_thread_create(pthread_t *tid, void *(*fn)(void *), void *arg)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, TOPO_STACK_SIZE);
+    int err = pthread_create(tid, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    if (err)
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+    return err;
+}
+
+int jitter_init(struct jitter *j, size_t cap)
+{
+    memset(j, 0, sizeof(*j));
+    j->samples = calloc(cap, sizeof(uint64_t));
+    if (!j->samples)
+        return -1;
+    j->cap = cap;
+    return 0;
+}
+
+int jitter_add(struct jitter *j, uint64_t ts_ns)
+{
+    if (j->last_ns && j->count < j->cap)
+        j->samples[j->count++] = ts_ns - j->last_ns;
+    j->last_ns = ts_ns;
+    return j->count >= j->cap;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_ms(const uint64_t *sorted, size_t n, double pct)
+{
+    size_t idx = (size_t)(pct / 100.0 * (double)(n - 1) + 0.5);
+    return sorted[idx] / 1e6;
+}
+
+void jitter_report(struct jitter *j, FILE *fp)
+{
+    size_t n = j->count;
+    if (n == 0) {
+        fprintf(fp, "jitter: no samples\n");
+        return;
+    }
+
+    qsort(j->samples, n, sizeof(uint64_t), cmp_u64);
+
+    double sum = 0, sq = 0;
+    for (size_t i = 0; i < n; ++i) {
+        double v = j->samples[i] / 1e6;
+        sum += v;
+        sq += v * v;
+    }
+    double mean = sum / n;
+    double stddev = sqrt(sq / n - mean * mean > 0 ? sq / n - mean * mean : 0);
+
+    fprintf(fp, "inter-frame interval over %zu frames (ms):\n", n);
+    fprintf(fp, "  min %.3f  mean %.3f  stddev %.3f  max %.3f\n",
+            j->samples[0] / 1e6, mean, stddev, j->samples[n - 1] / 1e6);
+    fprintf(fp, "  p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f\n",
+            percentile_ms(j->samples, n, 50), percentile_ms(j->samples, n, 90),
+            percentile_ms(j->samples, n, 99), percentile_ms(j->samples, n, 99.9));
+
+    // 1ms 宽的直方图，只打印非空桶
+    size_t i = 0;
+    while (i < n) {
+        uint64_t bucket = j->samples[i] / 1000000;
+        size_t cnt = 0;
+        while (i < n && j->samples[i] / 1000000 == bucket) {
+            cnt++;
+            i++;
+        }
+        int bar = (int)(cnt * 50 / n);
+        fprintf(fp, "  %4llu-%-4llu ms %8zu %.*s\n", (unsigned long long)bucket,
+                (unsigned long long)bucket + 1, cnt, bar > 0 ? bar : 1,
+                "##################################################");
+    }
+}
+
+void jitter_free(struct jitter *j)
+{
+    free(j->samples);
+    j->samples = NULL;
+    j->count = j->cap = 0;
+}
@@ -0,0 +1,106 @@
+// topology.h
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * 线程拓扑：采集、网络 I/O、串口 I/O、后台记录四类线程，
+ * 每类可单独绑定 CPU 并可选 SCHED_FIFO 实时优先级。
+ *
+ * 配置串格式 "<role>=<value>[,<role>=<value>...]"，role 为
+ * capture / net / serial / rec，例如：
+ *   -a capture=3,serial=2,net=1,rec=0
+ *   -p capture=80,serial=70
+ */
+
+enum topo_role {
+    TOPO_CAPTURE = 0,
+    TOPO_NETWORK,
+    TOPO_SERIAL,
+    TOPO_RECORDER,
+    TOPO_ROLES
+};
+
+/**
+ * @brief 解析 CPU 绑定配置
+ * @return 0 成功，-1 格式错误
+ */
+int topo_parse_affinity(const char *spec);
+
+/**
+ * @brief 解析 SCHED_FIFO 优先级配置（1..99，0 表示普通调度）
+ * @return 0 成功，-1 格式错误
+ */
+int topo_parse_priority(const char *spec);
+
+/**
+ * @brief 对线程应用角色配置（线程名、CPU 绑定、调度策略）
+ * @return 0 成功，-1 部分设置失败（已打印原因，线程继续以默认方式运行）
+ */
+int topo_apply(pthread_t tid, enum topo_role role);
+
+/**
+ * @brief 恢复普通调度：不绑定 CPU、SCHED_OTHER
+ *
+ * 线程会继承创建者的 CPU 绑定和实时优先级，由网络线程按需创建的
+ * 辅助线程（如录像回放）启动时调用，以免与热路径线程争抢。
+ * @return 0 成功，-1 部分设置失败（已打印原因）
+ */
+int topo_apply_default(pthread_t tid, const char *name);
+
+const char *topo_role_name(enum topo_role role);
+
+/**
+ * @brief 锁定当前及以后的全部内存，避免热路径上的缺页
+ */
+int topo_lock_memory(void);
+
+/*
+ * 所有工作线程使用固定的小栈：mlockall(MCL_FUTURE) 下默认的 8MB 线程栈
+ * 会整块锁进内存，线程一多就超出 RLIMIT_MEMLOCK。
+ */
+#define TOPO_STACK_SIZE (256 * 1024)
+
+/**
+ * @brief 以 TOPO_STACK_SIZE 栈创建线程
+ * @return 0 成功，否则为 pthread_create 的错误码（已打印原因）
+ */
+int topo_thread_create(pthread_t *tid, void *(*fn)(void *), void *arg);
+
+/*
+ * 帧间隔抖动统计（基准模式使用）
+ */
+struct jitter {
+    uint64_t *samples;      // 帧间隔，纳秒
+    size_t count;
+    size_t cap;
+    uint64_t last_ns;
+};
+
+int jitter_init(struct jitter *j, size_t cap);
+
+/**
+ * @brief 记录一帧到达时间
+ * @return 1 样本已满，0 继续
+ */
+int jitter_add(struct jitter *j, uint64_t ts_ns);
+
+/**
+ * @brief 输出间隔分布：最小/平均/标准差/分位数/最大值与直方图
+ */
+void jitter_report(struct jitter *j, FILE *fp);
+
+void jitter_free(struct jitter *j);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,293 @@
+// trace.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+
+#define TRACE_MASK (TRACE_RING_SIZE - 1)
+
+struct trace_event {
+    uint64_t ts_ns;
+    const char *name;
+    uint32_t dur_ns;
+    int32_t arg;
+};
+
+struct trace_ring {
+    uint64_t head;              // 只由所属线程写，导出线程 acquire 读
+    uint64_t start;             // 当前线程接手时的 head，之前的事件属于已退出的线程
+    int in_use;                 // 0：所属线程已退出，可被新线程接手
+    int tid;
+    char thread_name[16];
+    struct trace_ring *next;
+    struct trace_event ev[TRACE_RING_SIZE];
+};
+
+static struct trace_ring *g_rings = NULL;     // 无锁单链表，只增不删，空闲的环被复用
+static pthread_key_t g_ring_key;
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+static int g_enabled = -1;                    // -1：尚未读取环境变量
+static volatile sig_atomic_t g_dump_requested = 0;
+static int g_dump_running = 0;                // 后台导出进行中（dump_ring 的快照缓冲区只有一份）
+static __thread struct trace_ring *t_ring = NULL;
+
+uint64_t trace_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int trace_enabled(void)
+{
+    if (__builtin_expect(g_enabled < 0, 0)) {
+        const char *env = getenv("PSERVER_TRACE");
+        g_enabled = !(env && strcmp(env, "0") == 0);
+    }
+    return g_enabled;
+}
+
+// 线程退出时把环标记为空闲；按需创建的线程（如每个回放会话）因此不会无限增加内存
+static void ring_release(void *arg)
+{
+    struct trace_ring *ring = arg;
+    __atomic_store_n(&ring->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void key_init(void)
+{
+    pthread_key_create(&g_ring_key, ring_release);
+}
+
+// 接手一个空闲的环，没有返回 NULL
+static struct trace_ring *ring_reuse(void)
+{
+    for (struct trace_ring *r = __atomic_load_n(&g_rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+        int expected = 0;
+        if (__atomic_load_n(&r->in_use, __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&r->in_use, &expected, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return r;
+    }
+    return NULL;
+}
+
+static struct trace_ring *ring_get(void)
+{
+    if (__builtin_expect(t_ring != NULL, 1))
+        return t_ring;
+
+    pthread_once(&g_key_once, key_init);
+
+    int tid = (int)syscall(SYS_gettid);
+    struct trace_ring *ring = ring_reuse();
+    if (ring) {
+        // head 保持递增，导出线程据此判断覆盖；start 之前的事件不再导出
+        ring->tid = tid;
+        snprintf(ring->thread_name, sizeof(ring->thread_name), "tid %d", tid);
+        __atomic_store_n(&ring->start, ring->head, __ATOMIC_RELEASE);
+    } else {
+        ring = calloc(1, sizeof(*ring));
+        if (!ring)
+            return NULL;
+        ring->in_use = 1;
+        ring->tid = tid;
+        snprintf(ring->thread_name, sizeof(ring->thread_name), "tid %d", tid);
+
+        ring->next = __atomic_load_n(&g_rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&g_rings, &ring->next, ring, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+    pthread_setspecific(g_ring_key, ring);
+    t_ring = ring;
+    return ring;
+}
+
+void trace_thread_name(const char *name)
+{
+    if (!trace_enabled())
+        return;
+    struct trace_ring *ring = ring_get();
+    if (ring)
+        snprintf(ring->thread_name, sizeof(ring->thread_name), "%s", name);
+}
+
+static void trace_record(const char *name, uint64_t ts_ns, uint64_t dur_ns, int32_t arg)
+{
+    struct trace_ring *ring = ring_get();
+    if (!ring)
+        return;
+
+    uint64_t h = ring->head;
+    struct trace_event *ev = &ring->ev[h & TRACE_MASK];
+    ev->ts_ns = ts_ns;
+    ev->name = name;
+    ev->dur_ns = dur_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)dur_ns;
+    ev->arg = arg;
+    __atomic_store_n(&ring->head, h + 1, __ATOMIC_RELEASE);
+}
+
+void trace_complete(const char *name, uint64_t start_ns, int32_t arg)
+{
+    if (!trace_enabled())
+        return;
+    uint64_t now = trace_now_ns();
+    trace_record(name, start_ns, now - start_ns, arg);
+}
+
+void trace_instant(const char *name, int32_t arg)
+{
+    if (!trace_enabled())
+        return;
+    trace_record(name, trace_now_ns(), 0, arg);
+}
+
+static int dump_ring(FILE *fp, struct trace_ring *ring, int pid, int first)
+{
+    static struct trace_event snap[TRACE_RING_SIZE];   // 导出串行进行，避免大栈
+    int count = 0;
+
+    uint64_t h1 = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t start = __atomic_load_n(&ring->start, __ATOMIC_ACQUIRE);
+    uint64_t base = h1 > TRACE_RING_SIZE ? h1 - TRACE_RING_SIZE : 0;   // snap[0] 的序号
+    if (base < start)
+        base = start;
+    uint64_t begin = base;
+    for (uint64_t i = base; i < h1; ++i)
+        snap[i - base] = ring->ev[i & TRACE_MASK];
+
+    // 复制期间所属线程可能继续写，覆盖了最旧的若干条，丢弃它们
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t h2 = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    if (h2 > TRACE_RING_SIZE && h2 - TRACE_RING_SIZE > begin)
+        begin = h2 - TRACE_RING_SIZE;
+
+    fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", pid, ring->tid, ring->thread_name);
+
+    for (uint64_t i = begin; i < h1; ++i) {
+        const struct trace_event *ev = &snap[i - base];
+        if (ev->dur_ns)
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"pid\":%d,\"tid\":%d,\"args\":{\"arg\":%d}}",
+                    ev->name, ev->ts_ns / 1000.0, ev->dur_ns / 1000.0,
+                    pid, ring->tid, ev->arg);
+        else
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                    "\"pid\":%d,\"tid\":%d,\"args\":{\"arg\":%d}}",
+                    ev->name, ev->ts_ns / 1000.0, pid, ring->tid, ev->arg);
+        count++;
+    }
+    return count;
+}
+
+int trace_dump(const char *path)
+{
+    char defpath[64];
+    int pid = (int)getpid();
+    if (!path) {
+        snprintf(defpath, sizeof(defpath), "trace-%d.json", pid);
+        path = defpath;
+    }
+
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror("trace: fopen");
+        return -1;
+    }
+
+    int total = 0, first = 1;
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (struct trace_ring *r = __atomic_load_n(&g_rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+        total += dump_ring(fp, r, pid, first);
+        first = 0;
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    printf("trace: %d events written to %s\n", total, path);
+    return total;
+}
+
+static void on_dump_signal(int sig)
+{
+    (void)sig;
+    g_dump_requested = 1;
+}
+
+void trace_install_signal(int sig)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_dump_signal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(sig, &sa, NULL);
+}
+
+#define TRACE_DUMP_STACK (256 * 1024)
+
+static void *dump_thread(void *arg)
+{
+    char *path = arg;
+    trace_dump(path);
+    free(path);
+    __atomic_store_n(&g_dump_running, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int trace_dump_async(const char *path)
+{
+    if (__atomic_exchange_n(&g_dump_running, 1, __ATOMIC_ACQ_REL)) {
+        fprintf(stderr, "trace: dump already in progress\n");
+        return -1;
+    }
+
+    char *copy = path ? strdup(path) : NULL;
+    if (path && !copy)
+        goto fail;
+
+    // 普通调度、分离的小栈线程：调用者可能是 SCHED_FIFO 的热路径线程，
+    // 导出只在它空闲时运行
+    pthread_attr_t attr;
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, TRACE_DUMP_STACK);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &sp);
+
+    pthread_t tid;
+    int err = pthread_create(&tid, &attr, dump_thread, copy);
+    pthread_attr_destroy(&attr);
+    if (err) {
+        fprintf(stderr, "trace: pthread_create: %s\n", strerror(err));
+        free(copy);
+        goto fail;
+    }
+    return 0;
+
+fail:
+    __atomic_store_n(&g_dump_running, 0, __ATOMIC_RELEASE);
+    return -1;
+}
+
+int trace_poll(void)
+{
+    if (!g_dump_requested)
+        return 0;
+    g_dump_requested = 0;
+    trace_dump_async(NULL);
+    return 1;
+}
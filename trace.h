@@ -0,0 +1,77 @@
+// trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * 常开的逐帧时间线记录器
+ *
+ * 每个线程首次记录时分配一个私有环形缓冲区（只有本线程写，无锁），
+ * 线程退出后缓冲区留给之后创建的线程复用，
+ * 记录一次事件只需一次 clock_gettime 和几次普通存储。
+ * 收到信号或命令时把所有线程的缓冲区导出为 Chrome trace-event JSON，
+ * 可直接用 chrome://tracing 或 ui.perfetto.dev 打开。
+ *
+ * 事件名必须是字符串字面量（只保存指针）。
+ * 环境变量 PSERVER_TRACE=0 可关闭记录。
+ */
+
+#define TRACE_RING_SIZE 8192    // 每线程事件数，必须是 2 的幂
+
+/**
+ * @brief 单调时钟纳秒时间戳
+ */
+uint64_t trace_now_ns(void);
+
+/**
+ * @brief 设置当前线程在时间线中显示的名字
+ */
+void trace_thread_name(const char *name);
+
+/**
+ * @brief 记录一个从 start_ns 到现在的区间事件
+ * @param name 阶段名（字符串字面量）
+ * @param arg 附加参数，如缓冲区索引、客户端 fd、节点地址
+ */
+void trace_complete(const char *name, uint64_t start_ns, int32_t arg);
+
+/**
+ * @brief 记录一个瞬时事件
+ */
+void trace_instant(const char *name, int32_t arg);
+
+/**
+ * @brief 导出当前进程所有线程的事件
+ * @param path 输出文件；NULL 时使用 "trace-<pid>.json"
+ * @return 导出的事件数，失败返回 -1
+ */
+int trace_dump(const char *path);
+
+/**
+ * @brief 在后台线程中导出（普通调度优先级），调用者立即返回
+ * @param path 同 trace_dump
+ * @return 0 已开始，-1 上一次导出尚未结束或线程创建失败
+ */
+int trace_dump_async(const char *path);
+
+/**
+ * @brief 安装导出信号（如 SIGUSR1），处理函数只置标志
+ */
+void trace_install_signal(int sig);
+
+/**
+ * @brief 在主循环中调用：收到导出信号时开始后台导出
+ * @return 1 本次发起了导出，0 无请求
+ */
+int trace_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H